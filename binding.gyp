@@ -1,21 +1,52 @@
-{
-  "targets": [
-    {
-      "target_name": "homebridge-dht22",
-      "cflags!": [ "-fno-exceptions" ],
-      "cflags_cc!": [ "-fno-exceptions" ],
-      "sources": [
-        "src/binding/binding.cpp",
-        "src/binding/binding_utils.cpp",
-        "src/c/dht.c",
-        "src/c/bcm2835.c"
-      ],
-      "include_dirs": [
-        "<!@(node -p \"require('node-addon-api').include\")",
-        "src/c",
-        "src/binding"
-      ],
-      'defines': [ 'NAPI_DISABLE_CPP_EXCEPTIONS' ],
-    }
-  ]
-}
+{
+  "variables": {
+    # Set with GYP_DEFINES=simulator=true to build against a simulated
+    # sensor (src/c/fake-gpio.c) instead of the GPIO
+    "simulator%": "false"
+  },
+  "targets": [
+    {
+      "target_name": "homebridge-dht22",
+      "cflags!": [ "-fno-exceptions" ],
+      "cflags_cc!": [ "-fno-exceptions" ],
+      "sources": [
+        "src/binding/binding.cpp",
+        "src/binding/addon_data.cpp",
+        "src/binding/binding_utils.cpp",
+        "src/binding/columns_binding.cpp",
+        "src/binding/history.cpp",
+        "src/binding/journal_binding.cpp",
+        "src/binding/rollup_binding.cpp",
+        "src/c/dht.c",
+        "src/c/capture_engine.cpp",
+        "src/c/capture_ring.c",
+        "src/c/decode.c",
+        "src/c/filter.c",
+        "src/c/estimator.c",
+        "src/c/latency.c",
+        "src/c/model.c",
+        "src/c/stats.c",
+        "src/c/trace.c",
+        "src/c/vcd.c",
+        "src/c/ring.c",
+        "src/c/journal.c",
+        "src/c/rollup.c",
+        "src/c/columns.c",
+        "src/c/bcm2835.c"
+      ],
+      "include_dirs": [
+        "<!@(node -p \"require('node-addon-api').include\")",
+        "src/c",
+        "src/binding"
+      ],
+      'defines': [ 'NAPI_DISABLE_CPP_EXCEPTIONS', 'NAPI_VERSION=6' ],
+      "conditions": [
+        [ "simulator=='true'", {
+          "sources!": [ "src/c/bcm2835.c" ],
+          "sources": [ "src/c/fake-gpio.c" ],
+          "defines": [ "DHT_SIMULATOR" ]
+        } ]
+      ]
+    }
+  ]
+}
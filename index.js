@@ -1,208 +1,377 @@
-const DHT22 = require('bindings')('homebridge-dht22');
-
-const moment = require('moment'); // Time formatting
-const mqtt = require('mqtt'); // MQTT client
-const os = require('os'); // Hostname
-
-// Services represent a service provided by a device,
-// Characteristics represent an aspect of that service
-var Service, Characteristic;
-
-// Used for storing historical data
-var FakeGatoHistoryService;
-
-module.exports = homebridge => {
-  Service = homebridge.hap.Service;
-  Characteristic = homebridge.hap.Characteristic;
-  FakeGatoHistoryService = require('fakegato-history')(homebridge);
-
-  // Name of plugin, name of accessory, constructor
-  homebridge.registerAccessory('homebridge-dht22', 'DHT22', DHTAccessory);
-}
-
-// DHT constructor
-// Must instantiate: service, characteristics
-// AccessoryInformation service, with manufacturer/model/serialnumber
-// TemperatureSensor service, with current temperature and name
-// HumiditySensor service, with current humidity and name
-function DHTAccessory(log, config) {
-  // Basic setup from config file
-  this.log = log;
-  this.displayName = config['name'];
-  this.pin = config['pin'] || 4; // Use BCM pin numbers
-  this.refreshPeriod = config['refresh'] || 60;
-  this.maxRetries = config['maxRetries'] || 50;
-  this.maxTempDelta = config['maxTempDelta'] || 5;
-  this.maxHumDelta = config['maxHumDelta'] || 5;
-  this.tempOffset = config['tempOffset'] || 0;
-  this.humOffset = config['humOffset'] || 0;
-  this.enableFakeGato = config['enableFakeGato'] || false;
-  this.fakeGatoStoragePath = config['fakeGatoStoragePath'];
-  this.enableMQTT = config['enableMQTT'] || false;
-  this.mqttConfig = config['mqtt'];
-
-  // Internal variables to keep track of current temperature and humidity
-  this._currentTemp = null;
-  this._currentHum = null;
-
-  // Override some information about the accessory
-  let informationService = new Service.AccessoryInformation();
-  informationService
-    .setCharacteristic(Characteristic.Manufacturer, 'Adafruit')
-    .setCharacteristic(Characteristic.Model, 'DHT22')
-    .setCharacteristic(Characteristic.SerialNumber, `${os.hostname}-${this.pin}`)
-    .setCharacteristic(Characteristic.FirmwareRevision, require('./package.json').version);
-
-  // Add temperature and humidity sensor services
-  let temperatureService = new Service.TemperatureSensor();
-  let humidityService = new Service.HumiditySensor();
-
-  // Make these services available to class
-  this.informationService = informationService;
-  this.temperatureService = temperatureService;
-  this.humidityService = humidityService;
-
-  // Start FakeGato for logging historical data
-  if (this.enableFakeGato) {
-    this.fakeGatoHistoryService = new FakeGatoHistoryService('weather', this, {
-      storage: 'fs',
-      filename: `DHT22-${os.hostname}-${this.pin}.json`,
-      folder: this.fakeGatoStoragePath
-    });
-  }
-
-  // Set up MQTT client
-  if (this.enableMQTT) {
-    this.setUpMQTT();
-  }
-
-  // Periodically update the values
-  this.refreshData();
-  setInterval(() => this.refreshData(),
-              this.refreshPeriod * 1000);
-}
-
-// Getters and setters for temperature and humidity
-Object.defineProperty(DHTAccessory.prototype, 'temp', {
-  set: function(temperatureReading) {
-    // Check if read data is out of bounds of max delta
-    if (Math.abs(temperatureReading + this.tempOffset - this._currentTemperature)
-          > this.maxTempDelta
-        && this._currentTemperature) {
-      this.log(`Error: Temperature reading out of max delta: ` +
-               `Reading: ${temperatureReading}, Current: ${this._currentTemperature}`);
-      return;
-    }
-
-    // If it's not, then update the value of the characteristic
-    this._currentTemperature = temperatureReading + this.tempOffset;
-    this.temperatureService.getCharacteristic(Characteristic.CurrentTemperature)
-      .updateValue(this._currentTemperature);
-    if (this.enableFakeGato) {
-      this.fakeGatoHistoryService.addEntry({
-        time: moment().unix(),
-        temp: this._currentTemperature,
-      });
-    }
-    if (this.enableMQTT) {
-      this.publishToMQTT(this.temperatureTopic, this._currentTemperature);
-    }
-  },
-
-  get: function() {
-    return this._currentTemperature;
-  }
-});
-
-Object.defineProperty(DHTAccessory.prototype, 'hum', {
-  set: function(humidityReading) {
-    if (Math.abs(humidityReading + this.humOffset - this._currentHumidity)
-          > this.maxHumDelta
-        && this._currentHumidity) {
-      this.log(`Error: Humidity reading out of max delta: ` + 
-               `Reading: ${humidityReading}, Current: ${this._currentHumidity}`);
-      return;
-    }
-
-    this._currentHumidity = humidityReading + this.humOffset;
-    this.humidityService.getCharacteristic(Characteristic.CurrentRelativeHumidity)
-      .updateValue(this._currentHumidity);
-    if (this.enableFakeGato) {
-      this.fakeGatoHistoryService.addEntry({
-        time: moment().unix(),
-        humidity: this._currentHumidity,
-      });
-    }
-    if (this.enableMQTT) {
-      this.publishToMQTT(this.humidityTopic, this._currentHumidity);
-    }
-  },
-
-  get: function() {
-    return this._currentHumidity;
-  }
-});
-
-// Sets up MQTT client so that we can send data
-DHTAccessory.prototype.setUpMQTT = function() {
-  if (!this.enableMQTT) {
-    this.log.info('MQTT not enabled');
-    return;
-  }
-
-  if (!this.mqttConfig) {
-    this.log.error('No MQTT config found');
-    return;
-  }
-
-  this.mqttUrl = this.mqttConfig.url;
-  this.temperatureTopic = this.mqttConfig.temperatureTopic || 'dht22/temperature';
-  this.humidityTopic = this.mqttConfig.humidityTopic || 'dht22/humidity';
-
-  this.mqttClient = mqtt.connect(this.mqttUrl);
-  this.mqttClient.on('connect', () => {
-    this.log(`MQTT client connected to ${this.mqttUrl}`);
-  });
-  this.mqttClient.on('error', (err) => {
-    this.log(`MQTT client error: ${err}`);
-    client.end();
-  });
-}
-
-// Sends data to MQTT broker
-DHTAccessory.prototype.publishToMQTT = function(topic, value) {
-  if (!this.mqttClient.connected || !topic || !value) {
-    this.log.error('MQTT client not connected, or no topic or value for MQTT');
-    return;
-  }
-  this.mqttClient.publish(topic, String(value));
-}
-
-// Get data from the sensor
-DHTAccessory.prototype.refreshData = function() {
-  let data;
-  data = DHT22.getData(this.pin, this.maxRetries);
-
-  // If error, set to error state
-  if (data.hasOwnProperty('errcode')) {
-    this.log(`Error: ${data.errmsg}`);
-    // Updating a value with Error class sets status in HomeKit to 'Not responding'
-    this.temperatureService.getCharacteristic(Characteristic.CurrentTemperature)
-      .updateValue(Error(data.errmsg));
-    this.humidityService.getCharacteristic(Characteristic.CurrentRelativeHumidity)
-      .updateValue(Error(data.errmsg));
-    return;
-  }
-  
-  // Set temperature and humidity from what we polled
-  this.log(`Temp: ${data.temp}, Hum: ${data.hum}`);
-  this.temp = data.temp;
-  this.hum = data.hum;
-}
-
-DHTAccessory.prototype.getServices = function() {
-  return [this.informationService,
-          this.temperatureService,
-          this.humidityService,
-          this.fakeGatoHistoryService];
-}
+const DHT22 = require('bindings')('homebridge-dht22');
+const Metrics = require('./src/js/metrics'); // OpenMetrics exporter
+
+const moment = require('moment'); // Time formatting
+const mqtt = require('mqtt'); // MQTT client
+const os = require('os'); // Hostname
+const path = require('path'); // Journal file path
+
+// Services represent a service provided by a device,
+// Characteristics represent an aspect of that service
+var Service, Characteristic;
+
+// Margin added to the model's minimum interval between reads, in seconds,
+// both before reading again after an outlier and as the shortest refresh
+const READ_INTERVAL_MARGIN = 0.5;
+
+// Used for storing historical data
+var FakeGatoHistoryService;
+var StoragePath;
+
+module.exports = homebridge => {
+  Service = homebridge.hap.Service;
+  Characteristic = homebridge.hap.Characteristic;
+  FakeGatoHistoryService = require('fakegato-history')(homebridge);
+  StoragePath = homebridge.user.storagePath();
+
+  // Name of plugin, name of accessory, constructor
+  homebridge.registerAccessory('homebridge-dht22', 'DHT22', DHTAccessory);
+}
+
+// DHT constructor
+// Must instantiate: service, characteristics
+// AccessoryInformation service, with manufacturer/model/serialnumber
+// TemperatureSensor service, with current temperature and name
+// HumiditySensor service, with current humidity and name
+function DHTAccessory(log, config) {
+  // Basic setup from config file
+  this.log = log;
+  this.displayName = config['name'];
+  this.pin = config['pin'] || 4; // Use BCM pin numbers
+  this.modelInfo = DHT22.modelInfo(config['model'] || 'DHT22');
+  if (!this.modelInfo) {
+    this.log.error(`Unknown model ${config['model']}, reading as a DHT22`);
+    this.modelInfo = DHT22.modelInfo('DHT22');
+  }
+  this.rereadDelay = this.modelInfo.minInterval + READ_INTERVAL_MARGIN;
+  this.refreshPeriod = config['refresh'] || 60;
+  this.maxRetries = config['maxRetries'] || 50;
+  this.maxTempDelta = config['maxTempDelta'] || 5;
+  this.maxHumDelta = config['maxHumDelta'] || 5;
+  this.filterWindow = config['filterWindow'] || 7;
+  this.filterThreshold = config['filterThreshold'] || 3;
+  this.adaptiveRefresh = config['adaptiveRefresh'] || false;
+  this.minRefresh = Math.max(config['minRefresh'] || 5, this.rereadDelay);
+  this.maxRefresh = config['maxRefresh'] || 600;
+  // Offsets are applied in tenths, as readings come from the sensor, so
+  // stored and published values stay exact; strings from the config count
+  this.tempOffsetTenths = Math.round((Number(config['tempOffset']) || 0) * 10);
+  this.humOffsetTenths = Math.round((Number(config['humOffset']) || 0) * 10);
+  this.enableFakeGato = config['enableFakeGato'] || false;
+  this.fakeGatoStoragePath = config['fakeGatoStoragePath'];
+  this.enableMQTT = config['enableMQTT'] || false;
+  this.mqttConfig = config['mqtt'];
+  this.historyMemory = config['historyMemory'] || 256 * 1024;
+  this.enableJournal = config['enableJournal'] || false;
+  this.journalPath = config['journalPath'] || this.fakeGatoStoragePath || StoragePath;
+  this.journalBatchRecords = config['journalBatchRecords'] || 16;
+  this.journalBatchSeconds = config['journalBatchSeconds'] || 300;
+  this.rollupRetention = config['rollupRetention'] || {};
+  this.statsFile = config['statsFile'] !== undefined ? config['statsFile'] : '/dev/shm/dht22.stats';
+  this.metricsPort = config['metricsPort'];
+  this.metricsHost = config['metricsHost'];
+
+  // Internal variables to keep track of current temperature and humidity
+  this._currentTemperature = null;
+  this._currentHumidity = null;
+  this.lastReadingTime = null;
+
+  // Options and result of every read, reused so reads make no garbage
+  this.readOptions = {
+    filterWindow: this.filterWindow,
+    filterThreshold: this.filterThreshold,
+    tempMinDeviation: this.maxTempDelta,
+    humMinDeviation: this.maxHumDelta,
+    adaptive: this.adaptiveRefresh,
+    minInterval: this.minRefresh,
+    maxInterval: this.maxRefresh,
+    model: this.modelInfo.name,
+  };
+  this.reading = {};
+
+  // Counters for the metrics endpoint
+  this.readCount = 0;
+  this.errorCount = 0;
+  this.rejectedCount = 0;
+  this.blockedSeconds = 0;
+
+  // Override some information about the accessory
+  let informationService = new Service.AccessoryInformation();
+  informationService
+    .setCharacteristic(Characteristic.Manufacturer, 'Adafruit')
+    .setCharacteristic(Characteristic.Model, this.modelInfo.name)
+    .setCharacteristic(Characteristic.SerialNumber, `${os.hostname}-${this.pin}`)
+    .setCharacteristic(Characteristic.FirmwareRevision, require('./package.json').version);
+
+  // Add temperature and humidity sensor services
+  let temperatureService = new Service.TemperatureSensor();
+  let humidityService = new Service.HumiditySensor();
+
+  // Make these services available to class
+  this.informationService = informationService;
+  this.temperatureService = temperatureService;
+  this.humidityService = humidityService;
+
+  // Compressed in-memory history of accepted readings
+  this.history = new DHT22.History(this.historyMemory);
+
+  // Minute, hour and day aggregates of accepted readings
+  this.rollup = new DHT22.Rollup(this.rollupRetention);
+
+  // Start FakeGato for logging historical data
+  // With the journal enabled, FakeGato only keeps history in memory and is
+  // refilled from the journal, instead of rewriting its JSON file
+  if (this.enableFakeGato) {
+    this.fakeGatoHistoryService = new FakeGatoHistoryService('weather', this,
+      this.enableJournal ? {} : {
+        storage: 'fs',
+        filename: `DHT22-${os.hostname}-${this.pin}.json`,
+        folder: this.fakeGatoStoragePath
+      });
+  }
+
+  // Open the on-disk journal and replay it into the history
+  if (this.enableJournal) {
+    const journalFile =
+      path.join(this.journalPath, `DHT22-${os.hostname()}-${this.pin}.journal`);
+    try {
+      this.journal = new DHT22.Journal(journalFile,
+        this.journalBatchRecords, this.journalBatchSeconds);
+    } catch (err) {
+      this.log.error(`Couldn't open journal ${journalFile}, journal disabled: ${err.message}`);
+      this.enableJournal = false;
+    }
+  }
+  if (this.enableJournal) {
+    this.replayJournal();
+    // Batches are otherwise only committed on append, so commit what's
+    // pending even when reads stop
+    this.journalTimer = setInterval(() => this.journal.commit(),
+      this.journalBatchSeconds * 1000);
+    this.journalTimer.unref();
+    process.on('exit', () => this.journal.close());
+  }
+
+  // Shared read counters, shown by dht-stat
+  if (this.statsFile && !DHT22.enableStats(this.statsFile)) {
+    this.log.error(`Couldn't map stats file ${this.statsFile}`);
+  }
+
+  // Serve readings and read performance to Prometheus
+  if (this.metricsPort) {
+    this.metrics = Metrics.exporter(this.metricsPort, this.metricsHost, this.log)
+      .addSource({pin: this.pin, name: this.displayName});
+  }
+
+  // Set up MQTT client
+  if (this.enableMQTT) {
+    this.setUpMQTT();
+  }
+
+  // Periodically update the values; each refresh schedules the next
+  this.refreshData();
+}
+
+// Getters and setters for temperature and humidity
+// Both are set in tenths, the integers the sensor sends, and read in units
+Object.defineProperty(DHTAccessory.prototype, 'temp', {
+  set: function(temperatureTenths) {
+    this._currentTemperatureTenths = temperatureTenths + this.tempOffsetTenths;
+    this._currentTemperature = this._currentTemperatureTenths / 10;
+    this.temperatureService.getCharacteristic(Characteristic.CurrentTemperature)
+      .updateValue(this._currentTemperature);
+    if (this.enableMQTT) {
+      this.publishToMQTT(this.temperatureTopic, this._currentTemperatureTenths);
+    }
+  },
+
+  get: function() {
+    return this._currentTemperature;
+  }
+});
+
+Object.defineProperty(DHTAccessory.prototype, 'hum', {
+  set: function(humidityTenths) {
+    this._currentHumidityTenths = humidityTenths + this.humOffsetTenths;
+    this._currentHumidity = this._currentHumidityTenths / 10;
+    this.humidityService.getCharacteristic(Characteristic.CurrentRelativeHumidity)
+      .updateValue(this._currentHumidity);
+    if (this.enableMQTT) {
+      this.publishToMQTT(this.humidityTopic, this._currentHumidityTenths);
+    }
+  },
+
+  get: function() {
+    return this._currentHumidity;
+  }
+});
+
+// Sets up MQTT client so that we can send data
+DHTAccessory.prototype.setUpMQTT = function() {
+  if (!this.enableMQTT) {
+    this.log.info('MQTT not enabled');
+    return;
+  }
+
+  if (!this.mqttConfig) {
+    this.log.error('No MQTT config found');
+    return;
+  }
+
+  this.mqttUrl = this.mqttConfig.url;
+  this.temperatureTopic = this.mqttConfig.temperatureTopic || 'dht22/temperature';
+  this.humidityTopic = this.mqttConfig.humidityTopic || 'dht22/humidity';
+
+  this.mqttClient = mqtt.connect(this.mqttUrl);
+  this.mqttClient.on('connect', () => {
+    this.log(`MQTT client connected to ${this.mqttUrl}`);
+  });
+  this.mqttClient.on('error', (err) => {
+    this.log(`MQTT client error: ${err}`);
+    client.end();
+  });
+}
+
+// Formats an integer number of tenths, e.g. -5 as "-0.5", without going
+// through a double
+function formatTenths(tenths) {
+  const sign = tenths < 0 ? '-' : '';
+  const magnitude = Math.abs(tenths);
+  return `${sign}${Math.trunc(magnitude / 10)}.${magnitude % 10}`;
+}
+
+// Sends data, in tenths, to MQTT broker
+DHTAccessory.prototype.publishToMQTT = function(topic, tenths) {
+  if (!this.mqttClient.connected || !topic || !Number.isInteger(tenths)) {
+    this.log.error('MQTT client not connected, or no topic or value for MQTT');
+    return;
+  }
+  this.mqttClient.publish(topic, formatTenths(tenths));
+}
+
+// Schedules the next refresh in the given number of seconds,
+// replacing any refresh already scheduled
+DHTAccessory.prototype.scheduleRefresh = function(seconds) {
+  clearTimeout(this.refreshTimer);
+  this.refreshTimer = setTimeout(() => this.refreshData(), seconds * 1000);
+}
+
+// Get data from the sensor
+DHTAccessory.prototype.refreshData = function() {
+  const data = this.reading;
+  const started = process.hrtime();
+  DHT22.getDataInto(this.pin, this.maxRetries, data, this.readOptions);
+  const [seconds, nanoseconds] = process.hrtime(started);
+  this.blockedSeconds += seconds + nanoseconds / 1e9;
+  this.readCount++;
+
+  // If error, set to error state
+  if (data.errcode) {
+    this.errorCount++;
+    this.log(`Error: ${data.errmsg}`);
+    // Updating a value with Error class sets status in HomeKit to 'Not responding'
+    this.temperatureService.getCharacteristic(Characteristic.CurrentTemperature)
+      .updateValue(Error(data.errmsg));
+    this.humidityService.getCharacteristic(Characteristic.CurrentRelativeHumidity)
+      .updateValue(Error(data.errmsg));
+    this.scheduleRefresh(this.refreshPeriod);
+    this.updateMetrics();
+    return;
+  }
+
+  // Outliers never reach HomeKit, MQTT or history; read again as soon as
+  // the sensor allows instead of waiting for the next refresh
+  if (data.rejected) {
+    this.log(`Error: ${data.reason}: Temp: ${data.temp}, Hum: ${data.hum}`);
+    this.rejectedCount++;
+    this.scheduleRefresh(this.rereadDelay);
+    this.updateMetrics();
+    return;
+  }
+
+  // With adaptive refresh, the native estimator decides when to read next:
+  // rarely while readings match its prediction, quickly when they jump
+  if (this.adaptiveRefresh) {
+    this.log.debug(`Smoothed temp: ${data.smoothedTemp.toFixed(2)} ` +
+                   `(var ${data.tempVariance.toFixed(3)}), ` +
+                   `hum: ${data.smoothedHum.toFixed(2)} ` +
+                   `(var ${data.humVariance.toFixed(3)}), ` +
+                   `next read in ${data.nextRead.toFixed(1)} s`);
+    this.scheduleRefresh(data.nextRead);
+  } else {
+    this.scheduleRefresh(this.refreshPeriod);
+  }
+
+  // Set temperature and humidity from what we polled
+  this.log(`Temp: ${data.temp}, Hum: ${data.hum}`);
+  this.temp = data.tempTenths;
+  this.hum = data.humTenths;
+
+  // Record the accepted values once per reading
+  if (this._currentTemperature != null && this._currentHumidity != null) {
+    this.lastReadingTime = moment().unix();
+    this.recordHistory(this.lastReadingTime,
+                       this._currentTemperatureTenths, this._currentHumidityTenths);
+  }
+  this.updateMetrics();
+}
+
+// Re-renders this sensor's samples for the metrics endpoint
+DHTAccessory.prototype.updateMetrics = function() {
+  if (!this.metrics) {
+    return;
+  }
+  this.metrics.update({
+    temp: this._currentTemperature,
+    hum: this._currentHumidity,
+    time: this.lastReadingTime,
+    reads: this.readCount,
+    errors: this.errorCount,
+    rejected: this.rejectedCount,
+    blockedSeconds: this.blockedSeconds,
+    latency: DHT22.latencyHistogram(this.pin, Metrics.LATENCY_BOUNDS),
+    stats: DHT22.readStats(this.pin),
+  });
+}
+
+// Adds one reading, in tenths, to every enabled history store
+DHTAccessory.prototype.recordHistory = function(time, tempTenths, humTenths) {
+  const temp = tempTenths / 10;
+  const hum = humTenths / 10;
+  this.history.append(time, temp, hum);
+  this.rollup.add(time, temp, hum);
+  if (this.enableJournal) {
+    this.journal.appendTenths(time, tempTenths, humTenths);
+  }
+  if (this.enableFakeGato) {
+    this.fakeGatoHistoryService.addEntry({
+      time: time,
+      temp: temp,
+      humidity: hum,
+    });
+  }
+}
+
+// Loads readings from the journal into the in-memory history, rollups and FakeGato
+DHTAccessory.prototype.replayJournal = function() {
+  const readings = this.journal.replay();
+  for (let i = 0; i < readings.length; i += 4) {
+    this.history.append(readings[i], readings[i + 1], readings[i + 2], readings[i + 3]);
+    this.rollup.add(readings[i], readings[i + 1], readings[i + 2]);
+    if (this.enableFakeGato) {
+      this.fakeGatoHistoryService.addEntry({
+        time: readings[i],
+        temp: readings[i + 1],
+        humidity: readings[i + 2],
+      });
+    }
+  }
+  this.log(`Replayed ${readings.length / 4} readings from journal`);
+}
+
+DHTAccessory.prototype.getServices = function() {
+  return [this.informationService,
+          this.temperatureService,
+          this.humidityService,
+          this.fakeGatoHistoryService];
+}
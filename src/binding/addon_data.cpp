@@ -0,0 +1,62 @@
+#include "addon_data.h"
+
+#include <napi.h>
+
+#include <utility>
+
+static Napi::Reference<Napi::String> key(Napi::Env env, const char *name) {
+  return Napi::Persistent(Napi::String::New(env, name));
+}
+
+AddonData::AddonData(Napi::Env env)
+    : temp(key(env, "temp")),
+      hum(key(env, "hum")),
+      tempTenths(key(env, "tempTenths")),
+      humTenths(key(env, "humTenths")),
+      errcode(key(env, "errcode")),
+      errmsg(key(env, "errmsg")),
+      attempts(key(env, "attempts")),
+      rejected(key(env, "rejected")),
+      reason(key(env, "reason")),
+      nextRead(key(env, "nextRead")),
+      smoothedTemp(key(env, "smoothedTemp")),
+      smoothedHum(key(env, "smoothedHum")),
+      tempVariance(key(env, "tempVariance")),
+      humVariance(key(env, "humVariance")),
+      filterWindow(key(env, "filterWindow")),
+      filterThreshold(key(env, "filterThreshold")),
+      tempMinDeviation(key(env, "tempMinDeviation")),
+      humMinDeviation(key(env, "humMinDeviation")),
+      minInterval(key(env, "minInterval")),
+      maxInterval(key(env, "maxInterval")),
+      adaptive(key(env, "adaptive")),
+      model(key(env, "model")),
+      retries(key(env, "retries")),
+      out(key(env, "out")),
+      pins() {
+  for (int r = 0; r < FILTER_REASONS; r++) {
+    reasons[r] = key(env, filter_reason_str(r));
+  }
+  dht::Expected<dht::Session> opened = dht::Session::open();
+  if (opened) {
+    session = std::move(*opened);
+  }
+}
+
+// Runs when the environment is torn down, e.g. as a worker thread exits
+AddonData::~AddonData() {
+  for (PinState &state : pins) {
+    capture_ring_destroy(state.captures);
+    if (state.hooked) {
+      releaseAttemptHook();
+    }
+  }
+}
+
+void AddonData::Init(Napi::Env env) {
+  env.SetInstanceData(new AddonData(env));
+}
+
+AddonData *AddonData::Get(Napi::Env env) {
+  return env.GetInstanceData<AddonData>();
+}
@@ -0,0 +1,98 @@
+#ifndef ADDON_DATA
+#define ADDON_DATA
+
+extern "C" {
+#include "capture_ring.h"
+#include "dht.h"
+#include "estimator.h"
+#include "filter.h"
+#include "latency.h"
+#include "model.h"
+#include "trace.h"
+}
+
+#include "dht.hpp"
+
+#include <napi.h>
+
+#include <vector>
+
+// Rejection masks of enum filter_reason, each with its own reason string
+static const int FILTER_REASONS = (FILTER_TEMP_OUTLIER | FILTER_HUM_OUTLIER) + 1;
+
+// State kept for each pin between reads
+struct PinState {
+  bool filterEnabled;
+  struct filter filter;
+  bool estimatorEnabled;
+  struct estimator estimator;
+  struct latency_set latency;
+  int model;                                  // enum DHT_model, see getData
+  bool vcdEnabled;                            // See enableVcd
+  std::vector<struct trace_record> attempts;  // Of the last read, see vcdDump
+  struct capture_ring *captures;              // See captureBuffer
+  Napi::Reference<Napi::ArrayBuffer> captureBuffer;
+  bool hooked;                                // Counted by retainAttemptHook
+};
+
+// Install the attempt hook for the first pin whose attempts are kept, and
+// remove it after the last; defined with the hook in binding.cpp
+void retainAttemptHook();
+void releaseAttemptHook();
+
+// State of one instance of the addon, i.e. of each Node environment that
+// loads it, kept as the environment's instance data; the main thread and
+// every worker thread loading the addon each get their own, so filters,
+// estimators and capture rings aren't shared between them
+class AddonData {
+ public:
+  ~AddonData();
+
+  // Creates the instance data of env and attaches it
+  static void Init(Napi::Env env);
+
+  // Instance data of env, or NULL before Init
+  static AddonData *Get(Napi::Env env);
+
+  // Property keys of results and errors, created once so that filling a
+  // reused result object creates no strings
+  Napi::Reference<Napi::String> temp;
+  Napi::Reference<Napi::String> hum;
+  Napi::Reference<Napi::String> tempTenths;
+  Napi::Reference<Napi::String> humTenths;
+  Napi::Reference<Napi::String> errcode;
+  Napi::Reference<Napi::String> errmsg;
+  Napi::Reference<Napi::String> attempts;
+  Napi::Reference<Napi::String> rejected;
+  Napi::Reference<Napi::String> reason;
+  Napi::Reference<Napi::String> nextRead;
+  Napi::Reference<Napi::String> smoothedTemp;
+  Napi::Reference<Napi::String> smoothedHum;
+  Napi::Reference<Napi::String> tempVariance;
+  Napi::Reference<Napi::String> humVariance;
+
+  // Keys of the read options, and filter_reason_str of each rejection mask,
+  // likewise so that reading with options creates no strings
+  Napi::Reference<Napi::String> filterWindow;
+  Napi::Reference<Napi::String> filterThreshold;
+  Napi::Reference<Napi::String> tempMinDeviation;
+  Napi::Reference<Napi::String> humMinDeviation;
+  Napi::Reference<Napi::String> minInterval;
+  Napi::Reference<Napi::String> maxInterval;
+  Napi::Reference<Napi::String> adaptive;
+  Napi::Reference<Napi::String> model;
+  Napi::Reference<Napi::String> retries;
+  Napi::Reference<Napi::String> out;
+  Napi::Reference<Napi::String> reasons[FILTER_REASONS];
+
+  PinState pins[NUM_PINS];
+
+  // Keeps the driver mapped between reads while this instance lives; holds
+  // nothing if the driver couldn't be set up
+  dht::Session session;
+
+ private:
+  explicit AddonData(Napi::Env env);
+};
+
+#endif
@@ -1,48 +1,874 @@
-extern "C" {
-#include "dht.h"
-}
-
-#include "binding_utils.h"
-
-#include <napi.h>
-
-Napi::Object getData(const Napi::CallbackInfo &info) {
-  // Get arguments
-  int pin = info[0].As<Napi::Number>();
-  int retries = info[1].As<Napi::Number>();
-  Napi::Env env = info.Env();
-
-  // Variables to hold humidity and temperature
-  double humidity, temperature;
-
-  // Init pin
-  int err = DHT_init(pin);
-  if (err) {
-    DHT_deinit();
-    return BindingUtils::errFactory(env, err, "Could not initialize pin");
-  }
-
-  // Read data
-  err = DHT_read_data(pin, retries, &humidity, &temperature);
-  if (err) {
-    DHT_deinit();
-    return BindingUtils::errFactory(env, err, "Could not read data");
-  }
-
-  // Close pin
-  DHT_deinit();
-
-  // Put return values into an object
-  Napi::Object returnObject = Napi::Object::New(env);
-  returnObject.Set(Napi::String::New(env, "temp"), Napi::Number::New(env, temperature));
-  returnObject.Set(Napi::String::New(env, "hum"), Napi::Number::New(env, humidity));
-  return returnObject;
-}
-
-Napi::Object Init(Napi::Env env, Napi::Object exports) {
-  exports.Set(Napi::String::New(env, "getData"),
-              Napi::Function::New(env, getData));
-  return exports;
-}
-
-NODE_API_MODULE(homebridgedht22, Init)
+extern "C" {
+#include "capture_ring.h"
+#include "dht.h"
+#include "estimator.h"
+#include "filter.h"
+#include "latency.h"
+#include "model.h"
+#include "stats.h"
+#include "trace.h"
+#include "vcd.h"
+}
+
+#include "addon_data.h"
+#include "binding_utils.h"
+#include "columns_binding.h"
+#include "history.h"
+#include "journal_binding.h"
+#include "rollup_binding.h"
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Per-pin state lives in each instance's AddonData; what follows is shared by
+// every instance in the process, i.e. the main thread and worker threads,
+// since they all drive the same pins
+
+// Held while a pin is read, and while its attempts, latency or capture ring
+// are used; several are always taken in ascending order of pin
+static std::mutex pinLocks[NUM_PINS];
+
+// State of the instance reading each pin, for keepAttempt; only changed
+// while the pin's lock is held
+static PinState *readers[NUM_PINS];
+
+// Marks state as reading pin while in scope; the pin's lock must be held
+struct Reader {
+  Reader(int pin, PinState *state) : pin(pin) {
+    readers[pin] = state;
+  }
+  ~Reader() {
+    readers[pin] = NULL;
+  }
+  int pin;
+};
+
+// Shared counters file, see enableStats
+static std::mutex statsLock;
+static struct stats_file *statsFile;
+static std::string statsPath;
+
+// Pins, over every instance, whose attempts are kept for vcdDump or a
+// capture ring; keepAttempt is only installed while there are any, so
+// ordinary reads run no hook
+static std::mutex hookLock;
+static int hookUsers;
+
+// (Re)configures the outlier filter of a pin from the getData options
+// {filterWindow, filterThreshold, tempMinDeviation, humMinDeviation}
+static void configureFilter(const AddonData *keys, PinState &state,
+                            const Napi::Value options) {
+  int window = BindingUtils::getOption(options, keys->filterWindow.Value(), 0);
+  double threshold =
+    BindingUtils::getOption(options, keys->filterThreshold.Value(), -1);
+  double tempMinDev =
+    BindingUtils::getOption(options, keys->tempMinDeviation.Value(), -1);
+  double humMinDev =
+    BindingUtils::getOption(options, keys->humMinDeviation.Value(), -1);
+
+  struct filter wanted;
+  filter_init(&wanted, window, threshold,
+              tempMinDev < 0 ? -1 : std::lround(tempMinDev * 10),
+              humMinDev < 0 ? -1 : std::lround(humMinDev * 10));
+  if (!state.filterEnabled ||
+      wanted.window != state.filter.window ||
+      wanted.threshold != state.filter.threshold ||
+      wanted.temp_min_dev != state.filter.temp_min_dev ||
+      wanted.hum_min_dev != state.filter.hum_min_dev) {
+    state.filter = wanted;
+    state.filterEnabled = true;
+  }
+}
+
+// (Re)configures the estimator of a pin from the getData options
+// {minInterval, maxInterval}, keeping its state if they are unchanged
+static void configureEstimator(const AddonData *keys, PinState &state,
+                               const Napi::Value options) {
+  struct estimator wanted;
+  estimator_init(&wanted,
+                 BindingUtils::getOption(options, keys->minInterval.Value(), 0),
+                 BindingUtils::getOption(options, keys->maxInterval.Value(), 0));
+  if (!state.estimatorEnabled ||
+      wanted.min_interval != state.estimator.min_interval ||
+      wanted.max_interval != state.estimator.max_interval) {
+    state.estimator = wanted;
+    state.estimatorEnabled = true;
+  }
+}
+
+// Sets model from options.model, a name such as "DHT22" or "AM2301", leaving
+// it as it is if unset; returns false if the name is unknown
+static bool parseModel(const AddonData *keys, const Napi::Value options,
+                       int &model) {
+  if (!options.IsObject()) {
+    return true;
+  }
+  Napi::Value name = options.As<Napi::Object>().Get(keys->model.Value());
+  if (name.IsUndefined()) {
+    return true;
+  }
+  int parsed = name.IsString()
+    ? DHT_model_parse(name.As<Napi::String>().Utf8Value().c_str()) : -1;
+  if (parsed < 0) {
+    return false;
+  }
+  model = parsed;
+  return true;
+}
+
+// Attempt hook keeping the raw timings of each attempt of the read in
+// progress, for vcdDump if enabled and in the pin's capture ring if it has
+// one, in the state of the instance reading the pin
+static void keepAttempt(void *, const struct DHT_attempt *attempt) {
+  if (attempt->pin < 0 || attempt->pin >= NUM_PINS) {
+    return;
+  }
+  PinState *state = readers[attempt->pin];
+  if (!state) {
+    return;
+  }
+  if (state->vcdEnabled && state->attempts.size() < DHT_MAX_ATTEMPTS) {
+    state->attempts.emplace_back();
+    trace_fill(&state->attempts.back(), attempt);
+  }
+  capture_ring_push(state->captures, attempt);
+}
+
+void retainAttemptHook() {
+  std::lock_guard<std::mutex> lock(hookLock);
+  if (hookUsers++ == 0) {
+    DHT_set_attempt_hook(keepAttempt, NULL);
+  }
+}
+
+void releaseAttemptHook() {
+  std::lock_guard<std::mutex> lock(hookLock);
+  if (hookUsers > 0 && --hookUsers == 0) {
+    DHT_set_attempt_hook(NULL, NULL);
+  }
+}
+
+// Counts state among the hook's users while it keeps attempts; the pin's
+// lock must be held
+static void updateAttemptHook(PinState &state) {
+  bool wanted = state.vcdEnabled || state.captures;
+  if (wanted && !state.hooked) {
+    retainAttemptHook();
+  } else if (!wanted && state.hooked) {
+    releaseAttemptHook();
+  }
+  state.hooked = wanted;
+}
+
+static double monotonicSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Copies a read's diagnostics onto a JS object
+static void fillDiagnostics(Napi::Env env, Napi::Object out,
+                            const struct DHT_diagnostics &diag) {
+  int shown = diag.attempts < DHT_MAX_ATTEMPTS ? diag.attempts : DHT_MAX_ATTEMPTS;
+  Napi::Array stages = Napi::Array::New(env, shown);
+  for (int i = 0; i < shown; i++) {
+    stages.Set(i, Napi::String::New(env, DHT_stage_str(diag.stages[i])));
+  }
+  Napi::Uint16Array low = Napi::Uint16Array::New(env, NUM_BITS);
+  Napi::Uint16Array high = Napi::Uint16Array::New(env, NUM_BITS);
+  for (int i = 0; i < NUM_BITS; i++) {
+    low[i] = diag.low_cycles[i];
+    high[i] = diag.high_cycles[i];
+  }
+
+  out.Set("attempts", Napi::Number::New(env, diag.attempts));
+  out.Set("failures", stages);
+  out.Set("wallMs", Napi::Number::New(env, diag.wall_ns / 1e6));
+  out.Set("realtimePriority", Napi::Boolean::New(env, diag.realtime_priority));
+  out.Set("realtimeMs", Napi::Number::New(env, diag.rt_ns / 1e6));
+  out.Set("ackLowCycles", Napi::Number::New(env, diag.ack_low_cycles));
+  out.Set("ackHighCycles", Napi::Number::New(env, diag.ack_high_cycles));
+  out.Set("lowCycles", low);
+  out.Set("highCycles", high);
+  out.Set("bitsUs", Napi::Number::New(env, diag.bits_ns / 1e3));
+  out.Set("minMargin", Napi::Number::New(env, diag.min_margin));
+  out.Set("minMarginBit", Napi::Number::New(env, diag.min_margin_bit));
+  out.Set("monotonic", Napi::Number::New(env, diag.monotonic.tv_sec +
+                                              diag.monotonic.tv_nsec / 1e9));
+  out.Set("timestamp", Napi::Number::New(env, diag.realtime.tv_sec * 1e3 +
+                                              diag.realtime.tv_nsec / 1e6));
+}
+
+// Outcome of a read, see readPin
+struct ReadResult {
+  int err;
+  const char *errmsg;
+  bool read;                // Whether the pin was initialised and read
+  double temperature;
+  double humidity;
+  double temperatureTenths; // As the sensor sent them, integers
+  double humidityTenths;
+  int attempts;
+  int reason;               // enum filter_reason, if filtered
+  double nextRead;          // Suggested seconds until the next read, if adaptive
+  bool adaptive;            // Whether options.adaptive was set
+};
+
+// Reads pin, through its outlier filter if options is an object, and its
+// estimator if options.adaptive is also set; fills diag if not NULL
+static ReadResult readPin(AddonData *data, int pin, int retries,
+                          const Napi::Value options,
+                          struct DHT_diagnostics *diag) {
+  ReadResult result = {NO_ERROR, NULL, false, NAN, NAN, NAN, NAN, 0,
+                       FILTER_ACCEPTED, 0, false};
+  PinState &state = data->pins[pin];
+  std::lock_guard<std::mutex> lock(pinLocks[pin]);
+  Reader reader(pin, &state);
+  DHT_set_latency(pin, &state.latency);
+  state.attempts.clear();
+  bool filtered = options.IsObject();
+  if (filtered) {
+    configureFilter(data, state, options);
+  }
+  result.adaptive = filtered &&
+    options.As<Napi::Object>().Get(data->adaptive.Value()).ToBoolean().Value();
+  if (result.adaptive) {
+    configureEstimator(data, state, options);
+  }
+  if (!parseModel(data, options, state.model)) {
+    result.err = ERROR_INVAL;
+    result.errmsg = "Unknown model";
+    return result;
+  }
+  DHT_set_model(pin, state.model);
+
+  dht::Expected<dht::Pin> opened = dht::Pin::open(pin);
+  if (!opened) {
+    result.err = opened.error();
+    result.errmsg = "Could not initialize pin";
+    return result;
+  }
+
+  result.read = true;
+  dht::Expected<dht::Reading> reading = filtered
+    ? opened->readFiltered(retries, state.filter, result.reason, diag,
+                           &result.attempts)
+    : opened->read(retries, diag, &result.attempts);
+  if (!reading) {
+    result.err = reading.error();
+    result.errmsg = "Could not read data";
+    return result;
+  }
+  result.temperature = reading->temperature();
+  result.humidity = reading->humidity();
+  result.temperatureTenths = reading->temperatureTenths;
+  result.humidityTenths = reading->humidityTenths;
+
+  // Outliers are kept out of the estimator; suggest re-reading at the floor
+  if (result.adaptive) {
+    result.nextRead = result.reason == FILTER_ACCEPTED
+                      ? estimator_update(&state.estimator, monotonicSeconds(),
+                                         result.temperature, result.humidity)
+                      : state.estimator.min_interval;
+  }
+  return result;
+}
+
+// getData(pin, retries[, options[, diagnostics]])
+// With options, the reading goes through the pin's outlier filter and the
+// result also has rejected and reason properties
+// With options.adaptive, accepted readings also feed the pin's Kalman
+// estimator; the result then has smoothed values, their variances, and
+// nextRead, the suggested number of seconds until the next read
+// options.model names the sensor on the pin, see modelInfo; the pin keeps
+// it for later reads, and is a DHT22 until one is given
+// If diagnostics is an object, it is filled with the attempts made and the
+// timing of the read, whether or not the read succeeded
+// The result has temp and hum, and tempTenths and humTenths as integers
+Napi::Object getData(const Napi::CallbackInfo &info) {
+  // Get arguments
+  int pin = info[0].As<Napi::Number>();
+  int retries = info[1].As<Napi::Number>();
+  Napi::Env env = info.Env();
+  bool filtered = info.Length() > 2 && info[2].IsObject();
+  bool diagnose = info.Length() > 3 && info[3].IsObject();
+
+  if (pin < 0 || pin >= NUM_PINS) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pin");
+  }
+  struct DHT_diagnostics diag;
+  AddonData *data = AddonData::Get(env);
+  ReadResult result = readPin(data, pin, retries,
+                              filtered ? info[2] : env.Undefined(),
+                              diagnose ? &diag : NULL);
+  if (diagnose && result.read) {
+    fillDiagnostics(env, info[3].As<Napi::Object>(), diag);
+  }
+  if (result.err) {
+    return BindingUtils::errFactory(env, result.err, result.errmsg);
+  }
+
+  // Put return values into an object
+  const PinState &state = data->pins[pin];
+  bool adaptive = result.adaptive;
+  Napi::Object returnObject = Napi::Object::New(env);
+  returnObject.Set(Napi::String::New(env, "temp"), Napi::Number::New(env, result.temperature));
+  returnObject.Set(Napi::String::New(env, "hum"), Napi::Number::New(env, result.humidity));
+  returnObject.Set(Napi::String::New(env, "tempTenths"), Napi::Number::New(env, result.temperatureTenths));
+  returnObject.Set(Napi::String::New(env, "humTenths"), Napi::Number::New(env, result.humidityTenths));
+  if (filtered) {
+    returnObject.Set(Napi::String::New(env, "rejected"), Napi::Boolean::New(env, result.reason != FILTER_ACCEPTED));
+    returnObject.Set(Napi::String::New(env, "reason"), Napi::String::New(env, filter_reason_str(result.reason)));
+  }
+  if (adaptive && state.estimator.temp.initialised) {
+    returnObject.Set(Napi::String::New(env, "smoothedTemp"), Napi::Number::New(env, state.estimator.temp.x));
+    returnObject.Set(Napi::String::New(env, "smoothedHum"), Napi::Number::New(env, state.estimator.hum.x));
+    returnObject.Set(Napi::String::New(env, "tempVariance"), Napi::Number::New(env, state.estimator.temp.p));
+    returnObject.Set(Napi::String::New(env, "humVariance"), Napi::Number::New(env, state.estimator.hum.p));
+  }
+  if (adaptive) {
+    returnObject.Set(Napi::String::New(env, "nextRead"), Napi::Number::New(env, result.nextRead));
+  }
+  return returnObject;
+}
+
+// Slots of the Float64Array filled by getDataInto
+enum ResultField {
+  RESULT_TEMP,
+  RESULT_HUM,
+  RESULT_ERRCODE,
+  RESULT_ATTEMPTS,
+  RESULT_REJECTED,          // Only if the array is long enough
+  RESULT_NEXT_READ,
+  RESULT_TEMP_TENTHS,
+  RESULT_HUM_TENTHS,
+  RESULT_FIELDS,
+};
+
+static const char *resultFieldNames[RESULT_FIELDS] = {
+  "temp", "hum", "errcode", "attempts", "rejected", "nextRead",
+  "tempTenths", "humTenths",
+};
+
+// getDataInto(pin, retries, out[, options])
+// Reads like getData, but fills out instead of returning a new object, and
+// returns the error code, 0 on success. out is either a Float64Array laid
+// out as resultFields, of at least 4 elements, or an object that gets temp,
+// hum, tempTenths, humTenths, errcode, errmsg and attempts, with options
+// rejected, reason and nextRead, and with options.adaptive the smoothed
+// values and variances. The tenths are the integers the sensor sent, for
+// storing without rounding. Temperature and humidity are NaN after an error.
+// With a Float64Array the call allocates nothing on the JS heap
+Napi::Value getDataInto(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int pin = info[0].As<Napi::Number>();
+  int retries = info[1].As<Napi::Number>();
+  Napi::Value out = info[2];
+  bool isArray = out.IsTypedArray() &&
+    out.As<Napi::TypedArray>().TypedArrayType() == napi_float64_array;
+  if (pin < 0 || pin >= NUM_PINS || !(isArray || out.IsObject()) ||
+      (isArray && out.As<Napi::Float64Array>().ElementLength() <= RESULT_ATTEMPTS)) {
+    return Napi::Number::New(env, ERROR_INVAL);
+  }
+  bool filtered = info.Length() > 3 && info[3].IsObject();
+  AddonData *data = AddonData::Get(env);
+  ReadResult result = readPin(data, pin, retries,
+                              filtered ? info[3] : env.Undefined(), NULL);
+
+  if (isArray) {
+    Napi::Float64Array array = out.As<Napi::Float64Array>();
+    double *values = array.Data();
+    values[RESULT_TEMP] = result.temperature;
+    values[RESULT_HUM] = result.humidity;
+    values[RESULT_ERRCODE] = result.err;
+    values[RESULT_ATTEMPTS] = result.attempts;
+    if (array.ElementLength() > RESULT_REJECTED) {
+      values[RESULT_REJECTED] = result.reason != FILTER_ACCEPTED;
+    }
+    if (array.ElementLength() > RESULT_NEXT_READ) {
+      values[RESULT_NEXT_READ] = result.nextRead;
+    }
+    if (array.ElementLength() > RESULT_HUM_TENTHS) {
+      values[RESULT_TEMP_TENTHS] = result.temperatureTenths;
+      values[RESULT_HUM_TENTHS] = result.humidityTenths;
+    }
+    return Napi::Number::New(env, result.err);
+  }
+
+  AddonData *keys = data;
+  Napi::Object object = out.As<Napi::Object>();
+  object.Set(keys->temp.Value(), Napi::Number::New(env, result.temperature));
+  object.Set(keys->hum.Value(), Napi::Number::New(env, result.humidity));
+  object.Set(keys->tempTenths.Value(), Napi::Number::New(env, result.temperatureTenths));
+  object.Set(keys->humTenths.Value(), Napi::Number::New(env, result.humidityTenths));
+  object.Set(keys->errcode.Value(), Napi::Number::New(env, result.err));
+  object.Set(keys->errmsg.Value(), result.errmsg
+             ? Napi::Value(Napi::String::New(env, result.errmsg)) : env.Undefined());
+  object.Set(keys->attempts.Value(), Napi::Number::New(env, result.attempts));
+  if (filtered) {
+    object.Set(keys->rejected.Value(), Napi::Boolean::New(env, result.reason != FILTER_ACCEPTED));
+    object.Set(keys->reason.Value(), keys->reasons[result.reason].Value());
+    object.Set(keys->nextRead.Value(), Napi::Number::New(env, result.nextRead));
+  }
+  const struct estimator &estimator = data->pins[pin].estimator;
+  if (result.adaptive && !result.err && estimator.temp.initialised) {
+    object.Set(keys->smoothedTemp.Value(), Napi::Number::New(env, estimator.temp.x));
+    object.Set(keys->smoothedHum.Value(), Napi::Number::New(env, estimator.hum.x));
+    object.Set(keys->tempVariance.Value(), Napi::Number::New(env, estimator.temp.p));
+    object.Set(keys->humVariance.Value(), Napi::Number::New(env, estimator.hum.p));
+  }
+  return Napi::Number::New(env, result.err);
+}
+
+// Values per pin in the Float64Array of getDataBatch, the first ones of
+// resultFields
+static const int BATCH_FIELDS = RESULT_ATTEMPTS + 1;
+
+// Arguments of getDataBatch
+struct BatchArgs {
+  std::vector<int> pins;
+  int retries;
+  int model;                // enum DHT_model, or -1 to keep each pin's
+  Napi::Float64Array out;   // Empty unless options.out was given
+};
+
+// Parses getDataBatch(pins[, options]); returns false if they're invalid
+static bool parseBatchArgs(const Napi::CallbackInfo &info, BatchArgs &args) {
+  if (!info[0].IsArray()) {
+    return false;
+  }
+  Napi::Array pins = info[0].As<Napi::Array>();
+  for (uint32_t i = 0; i < pins.Length(); i++) {
+    Napi::Value value = pins.Get(i);
+    int pin = value.IsNumber() ? value.As<Napi::Number>().Int32Value() : -1;
+    if (pin < 0 || pin >= NUM_PINS ||
+        std::find(args.pins.begin(), args.pins.end(), pin) != args.pins.end()) {
+      return false;
+    }
+    args.pins.push_back(pin);
+  }
+
+  Napi::Value options = info[1];
+  const AddonData *keys = AddonData::Get(info.Env());
+  args.retries = BindingUtils::getOption(options, keys->retries.Value(), RETRIES);
+  args.model = -1;
+  if (!parseModel(keys, options, args.model)) {
+    return false;
+  }
+  if (options.IsObject()) {
+    Napi::Value out = options.As<Napi::Object>().Get(keys->out.Value());
+    if (out.IsTypedArray()) {
+      if (out.As<Napi::TypedArray>().TypedArrayType() != napi_float64_array ||
+          out.As<Napi::Float64Array>().ElementLength() < args.pins.size() * BATCH_FIELDS) {
+        return false;
+      }
+      args.out = out.As<Napi::Float64Array>();
+    }
+  }
+  return true;
+}
+
+// Reads pins, valid and distinct, as one batch into readings, keeping their
+// attempts like readPin
+static void readBatch(AddonData *data, const std::vector<int> &pins,
+                      int retries, int model,
+                      std::vector<struct DHT_reading> &readings) {
+  std::vector<int> sorted(pins);
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (int pin : sorted) {
+    locks.emplace_back(pinLocks[pin]);
+    PinState &state = data->pins[pin];
+    readers[pin] = &state;
+    DHT_set_latency(pin, &state.latency);
+    if (model >= 0) {
+      state.model = model;
+    }
+    DHT_set_model(pin, state.model);
+    state.attempts.clear();
+  }
+
+  readings.resize(pins.size());
+  data->session.readBatch(pins.data(), pins.size(), retries, readings.data());
+  for (int pin : sorted) {
+    readers[pin] = NULL;
+  }
+}
+
+static void packReadings(const std::vector<struct DHT_reading> &readings,
+                         double *values) {
+  for (const struct DHT_reading &reading : readings) {
+    values[RESULT_TEMP] = reading.temperature;
+    values[RESULT_HUM] = reading.humidity;
+    values[RESULT_ERRCODE] = reading.err;
+    values[RESULT_ATTEMPTS] = reading.attempts;
+    values += BATCH_FIELDS;
+  }
+}
+
+// getDataBatch(pins[, options])
+// Reads every pin in one call, mapping the driver and raising the priority
+// once for all of them. Returns a Float64Array of temp, hum, errcode and
+// attempts for each pin in turn, or options.out filled the same way if it is
+// a large enough Float64Array; the readings don't go through the filters or
+// estimators of the pins. options.retries defaults to 30, and
+// options.model, if given, is set on every pin as for getData
+Napi::Value getDataBatch(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  BatchArgs args;
+  if (!parseBatchArgs(info, args)) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pins or options");
+  }
+
+  std::vector<struct DHT_reading> readings;
+  readBatch(AddonData::Get(env), args.pins, args.retries, args.model,
+            readings);
+  Napi::Float64Array out = args.out.IsEmpty()
+    ? Napi::Float64Array::New(env, readings.size() * BATCH_FIELDS) : args.out;
+  packReadings(readings, out.Data());
+  return out;
+}
+
+// Reads a batch on the worker pool for getDataBatchAsync
+class BatchWorker : public Napi::AsyncWorker {
+ public:
+  BatchWorker(Napi::Env env, const BatchArgs &args)
+    : Napi::AsyncWorker(env, "getDataBatch"),
+      deferred(Napi::Promise::Deferred::New(env)),
+      data(AddonData::Get(env)), pins(args.pins), retries(args.retries),
+      model(args.model) {
+    if (!args.out.IsEmpty()) {
+      out = Napi::Persistent(args.out);
+    }
+  }
+
+  Napi::Promise Promise() const {
+    return deferred.Promise();
+  }
+
+ protected:
+  void Execute() override {
+    readBatch(data, pins, retries, model, readings);
+  }
+
+  // JS memory is only touched back on the main thread
+  void OnOK() override {
+    Napi::Env env = Env();
+    Napi::Float64Array array = out.IsEmpty()
+      ? Napi::Float64Array::New(env, readings.size() * BATCH_FIELDS) : out.Value();
+    packReadings(readings, array.Data());
+    deferred.Resolve(array);
+  }
+
+ private:
+  Napi::Promise::Deferred deferred;
+  Napi::Reference<Napi::Float64Array> out;
+  AddonData *data;
+  std::vector<int> pins;
+  int retries;
+  int model;
+  std::vector<struct DHT_reading> readings;
+};
+
+// getDataBatchAsync(pins[, options])
+// Like getDataBatch, but reads on the worker pool and returns a Promise of
+// the Float64Array; reads of the same pins wait for the batch to finish
+Napi::Value getDataBatchAsync(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  BatchArgs args;
+  if (!parseBatchArgs(info, args)) {
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+    deferred.Reject(BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pins or options"));
+    return deferred.Promise();
+  }
+
+  // The worker deletes itself once it has resolved the Promise
+  BatchWorker *worker = new BatchWorker(env, args);
+  worker->Queue();
+  return worker->Promise();
+}
+
+// latencySnapshot(pin)
+// Returns {phase: {count, min, mean, p50, p90, p99, p999, max}} in
+// microseconds for each phase of the reads on pin since the last snapshot,
+// then starts the histograms afresh
+Napi::Value latencySnapshot(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int pin = info[0].As<Napi::Number>();
+  if (pin < 0 || pin >= NUM_PINS) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pin");
+  }
+
+  std::lock_guard<std::mutex> lock(pinLocks[pin]);
+  struct latency_set &latency = AddonData::Get(env)->pins[pin].latency;
+  Napi::Object snapshot = Napi::Object::New(env);
+  for (int i = 0; i < LATENCY_PHASES; i++) {
+    const struct latency_histogram &hist = latency.phases[i];
+    Napi::Object phase = Napi::Object::New(env);
+    phase.Set("count", Napi::Number::New(env, hist.count));
+    phase.Set("min", Napi::Number::New(env, (hist.count ? hist.min_ns : 0) / 1e3));
+    phase.Set("mean", Napi::Number::New(env, hist.count ? hist.sum_ns / 1e3 / hist.count : 0));
+    phase.Set("p50", Napi::Number::New(env, latency_percentile(&hist, 0.5) / 1e3));
+    phase.Set("p90", Napi::Number::New(env, latency_percentile(&hist, 0.9) / 1e3));
+    phase.Set("p99", Napi::Number::New(env, latency_percentile(&hist, 0.99) / 1e3));
+    phase.Set("p999", Napi::Number::New(env, latency_percentile(&hist, 0.999) / 1e3));
+    phase.Set("max", Napi::Number::New(env, hist.max_ns / 1e3));
+    snapshot.Set(latency_phase_str(i), phase);
+  }
+  latency_reset(&latency);
+  return snapshot;
+}
+
+// latencyDump(pin)
+// Returns the latency histograms of pin as a text table, without resetting
+Napi::Value latencyDump(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int pin = info[0].As<Napi::Number>();
+  if (pin < 0 || pin >= NUM_PINS) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pin");
+  }
+
+  std::lock_guard<std::mutex> lock(pinLocks[pin]);
+  const struct latency_set &latency = AddonData::Get(env)->pins[pin].latency;
+  std::vector<char> table(latency_format(&latency, NULL, 0) + 1);
+  latency_format(&latency, table.data(), table.size());
+  return Napi::String::New(env, table.data());
+}
+
+// latencyHistogram(pin, bounds)
+// Returns {phase: {count, sum, buckets}} for each phase of the reads on pin,
+// without resetting; sum is in seconds and buckets is a Float64Array of the
+// cumulative number of reads taking at most each of bounds, in seconds
+Napi::Value latencyHistogram(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int pin = info[0].As<Napi::Number>();
+  if (pin < 0 || pin >= NUM_PINS || !info[1].IsTypedArray()) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pin or bounds");
+  }
+
+  Napi::Float64Array boundsArray = info[1].As<Napi::Float64Array>();
+  size_t n = boundsArray.ElementLength();
+  std::vector<uint64_t> bounds(n), counts(n);
+  for (size_t i = 0; i < n; i++) {
+    bounds[i] = boundsArray[i] * 1e9;
+  }
+
+  std::lock_guard<std::mutex> lock(pinLocks[pin]);
+  const struct latency_set &latency = AddonData::Get(env)->pins[pin].latency;
+  Napi::Object histograms = Napi::Object::New(env);
+  for (int i = 0; i < LATENCY_PHASES; i++) {
+    const struct latency_histogram &hist = latency.phases[i];
+    latency_cumulative(&hist, bounds.data(), n, counts.data());
+    Napi::Float64Array buckets = Napi::Float64Array::New(env, n);
+    for (size_t j = 0; j < n; j++) {
+      buckets[j] = counts[j];
+    }
+
+    Napi::Object phase = Napi::Object::New(env);
+    phase.Set("count", Napi::Number::New(env, hist.count));
+    phase.Set("sum", Napi::Number::New(env, hist.sum_ns / 1e9));
+    phase.Set("buckets", buckets);
+    histograms.Set(latency_phase_str(i), phase);
+  }
+  return histograms;
+}
+
+// enableVcd(pin[, enabled])
+// Starts, or with enabled false stops, keeping the attempts of each read on
+// pin for vcdDump; off by default, as keeping them costs time in every
+// attempt
+Napi::Value enableVcd(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int pin = info[0].As<Napi::Number>();
+  if (pin < 0 || pin >= NUM_PINS) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pin");
+  }
+  bool enabled = info.Length() < 2 || info[1].ToBoolean().Value();
+
+  std::lock_guard<std::mutex> lock(pinLocks[pin]);
+  PinState &state = AddonData::Get(env)->pins[pin];
+  state.vcdEnabled = enabled;
+  if (!enabled) {
+    state.attempts.clear();
+  }
+  updateAttemptHook(state);
+  return Napi::Boolean::New(env, enabled);
+}
+
+// vcdDump(pin)
+// Returns a Buffer holding a Value Change Dump of the attempts of the last
+// read on pin, for GTKWave or sigrok; empty unless enableVcd was called
+// before that read
+Napi::Value vcdDump(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int pin = info[0].As<Napi::Number>();
+  if (pin < 0 || pin >= NUM_PINS) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pin");
+  }
+
+  std::lock_guard<std::mutex> lock(pinLocks[pin]);
+  const std::vector<struct trace_record> &attempts =
+    AddonData::Get(env)->pins[pin].attempts;
+  std::vector<char> dump(vcd_format(attempts.data(), attempts.size(), NULL, 0) + 1);
+  vcd_format(attempts.data(), attempts.size(), dump.data(), dump.size());
+  return Napi::Buffer<char>::Copy(env, dump.data(), dump.size() - 1);
+}
+
+// modelInfo(name)
+// Returns {name, startLowUs, minInterval} of the sensor model called name,
+// minInterval in seconds, or undefined if the model is unknown
+Napi::Value modelInfo(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int model = info[0].IsString()
+    ? DHT_model_parse(info[0].As<Napi::String>().Utf8Value().c_str()) : -1;
+  const struct DHT_model_info *model_info = DHT_model_info(model);
+  if (!model_info) {
+    return env.Undefined();
+  }
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("name", Napi::String::New(env, model_info->name));
+  result.Set("startLowUs", Napi::Number::New(env, model_info->start_low_us));
+  result.Set("minInterval", Napi::Number::New(env, model_info->min_interval_ms / 1e3));
+  return result;
+}
+
+// captureBuffer(pin[, slots])
+// Returns an ArrayBuffer over the ring of the raw timings of the last slots
+// attempts on pin, 16 by default, laid out as in capture_ring.h; see
+// src/js/capture.js for views over it. The ring is created on the first call
+// and keeps its size and memory for the life of the instance; every attempt
+// on pin by this instance overwrites its oldest slot in place
+Napi::Value captureBuffer(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int pin = info[0].As<Napi::Number>();
+  if (pin < 0 || pin >= NUM_PINS) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pin");
+  }
+
+  std::lock_guard<std::mutex> lock(pinLocks[pin]);
+  PinState &state = AddonData::Get(env)->pins[pin];
+  if (!state.captures) {
+    int slots = info.Length() > 1 && info[1].IsNumber()
+                ? info[1].As<Napi::Number>().Int32Value() : CAPTURE_RING_SLOTS;
+    state.captures = capture_ring_create(slots > 0 ? slots : 0);
+    if (!state.captures) {
+      return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid number of slots");
+    }
+
+    // V8 allows one ArrayBuffer per block of external memory, so the same
+    // one is handed out on every call
+    state.captureBuffer = Napi::Persistent(
+      Napi::ArrayBuffer::New(env, state.captures, capture_ring_bytes(state.captures)));
+    updateAttemptHook(state);
+  }
+  return state.captureBuffer.Value();
+}
+
+// readStats(pin)
+// Returns the shared counters of pin, or null if stats are not enabled
+Napi::Value readStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int pin = info[0].As<Napi::Number>();
+  if (pin < 0 || pin >= NUM_PINS) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Invalid pin");
+  }
+  std::lock_guard<std::mutex> lock(statsLock);
+  if (!statsFile) {
+    return env.Null();
+  }
+
+  struct stats_pin counters;
+  stats_snapshot(statsFile, pin, &counters);
+  Napi::Object stats = Napi::Object::New(env);
+  stats.Set("reads", Napi::Number::New(env, counters.reads));
+  stats.Set("successes", Napi::Number::New(env, counters.successes));
+  stats.Set("attempts", Napi::Number::New(env, counters.attempts));
+  stats.Set("retries", Napi::Number::New(env, counters.retries));
+  stats.Set("responseLowTimeouts", Napi::Number::New(env, counters.response_low_timeouts));
+  stats.Set("responseHighTimeouts", Napi::Number::New(env, counters.response_high_timeouts));
+  stats.Set("bitTimeouts", Napi::Number::New(env, counters.bit_timeouts));
+  stats.Set("parityFailures", Napi::Number::New(env, counters.parity_failures));
+  stats.Set("rangeFailures", Napi::Number::New(env, counters.range_failures));
+  stats.Set("busySeconds", Napi::Number::New(env, counters.busy_ns / 1e9));
+  return stats;
+}
+
+// enableStats(path)
+// Counts reads of every pin in the shared stats file at path, creating it if
+// needed; an empty path stops counting. Returns whether the file is mapped
+Napi::Value enableStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  std::string path = info[0].IsString() ? info[0].As<Napi::String>().Utf8Value() : "";
+
+  // No pin may be read while the file is swapped
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (std::mutex &pinLock : pinLocks) {
+    locks.emplace_back(pinLock);
+  }
+  std::lock_guard<std::mutex> lock(statsLock);
+  if (statsFile && path == statsPath) {
+    return Napi::Boolean::New(env, true);
+  }
+
+  DHT_set_stats(NULL);
+  stats_close(statsFile);
+  statsFile = path.empty() ? NULL : stats_open(path.c_str(), 1);
+  statsPath = statsFile ? path : "";
+  DHT_set_stats(statsFile);
+  return Napi::Boolean::New(env, statsFile != NULL);
+}
+
+Napi::Object Init(Napi::Env env, Napi::Object exports) {
+  AddonData::Init(env);
+
+  Napi::Array fields = Napi::Array::New(env, RESULT_FIELDS);
+  for (int i = 0; i < RESULT_FIELDS; i++) {
+    fields.Set(i, Napi::String::New(env, resultFieldNames[i]));
+  }
+  exports.Set(Napi::String::New(env, "resultFields"), fields);
+#ifdef DHT_SIMULATOR
+  exports.Set(Napi::String::New(env, "backend"), Napi::String::New(env, "simulator"));
+#else
+  exports.Set(Napi::String::New(env, "backend"), Napi::String::New(env, "bcm2835"));
+#endif
+
+  exports.Set(Napi::String::New(env, "getData"),
+              Napi::Function::New(env, getData));
+  exports.Set(Napi::String::New(env, "getDataInto"),
+              Napi::Function::New(env, getDataInto));
+  exports.Set(Napi::String::New(env, "getDataBatch"),
+              Napi::Function::New(env, getDataBatch));
+  exports.Set(Napi::String::New(env, "getDataBatchAsync"),
+              Napi::Function::New(env, getDataBatchAsync));
+  exports.Set(Napi::String::New(env, "modelInfo"),
+              Napi::Function::New(env, modelInfo));
+  exports.Set(Napi::String::New(env, "latencySnapshot"),
+              Napi::Function::New(env, latencySnapshot));
+  exports.Set(Napi::String::New(env, "latencyDump"),
+              Napi::Function::New(env, latencyDump));
+  exports.Set(Napi::String::New(env, "latencyHistogram"),
+              Napi::Function::New(env, latencyHistogram));
+  exports.Set(Napi::String::New(env, "enableStats"),
+              Napi::Function::New(env, enableStats));
+  exports.Set(Napi::String::New(env, "readStats"),
+              Napi::Function::New(env, readStats));
+  exports.Set(Napi::String::New(env, "enableVcd"),
+              Napi::Function::New(env, enableVcd));
+  exports.Set(Napi::String::New(env, "vcdDump"),
+              Napi::Function::New(env, vcdDump));
+  exports.Set(Napi::String::New(env, "captureBuffer"),
+              Napi::Function::New(env, captureBuffer));
+  History::Init(env, exports);
+  Journal::Init(env, exports);
+  Rollup::Init(env, exports);
+  ColumnsBinding::Init(env, exports);
+  return exports;
+}
+
+NODE_API_MODULE(homebridgedht22, Init)
@@ -1,3 +1,5 @@
+#include "addon_data.h"
+
 #include <napi.h>
 
 namespace BindingUtils {
@@ -5,9 +7,23 @@ namespace BindingUtils {
 Napi::Object errFactory(const Napi::Env env,
                         const int errcode, const char *errmsg) {
   Napi::Object errorObject = Napi::Object::New(env);
+  AddonData *keys = AddonData::Get(env);
+  if (keys) {
+    errorObject.Set(keys->errcode.Value(), Napi::Number::New(env, errcode));
+    errorObject.Set(keys->errmsg.Value(), Napi::String::New(env, errmsg));
+    return errorObject;
+  }
   errorObject.Set(Napi::String::New(env, "errcode"), Napi::Number::New(env, errcode));
   errorObject.Set(Napi::String::New(env, "errmsg"), Napi::String::New(env, errmsg));
   return errorObject;
 }
 
+double getOption(const Napi::Value options, const Napi::Value key, double fallback) {
+  if (!options.IsObject()) {
+    return fallback;
+  }
+  Napi::Value value = options.As<Napi::Object>().Get(key);
+  return value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : fallback;
+}
+
 }
@@ -9,6 +9,10 @@ namespace BindingUtils {
 Napi::Object errFactory(const Napi::Env env,
                         const int errcode, const char *errmsg);
 
+// Gets a number from an options object, or fallback if it is not set; key
+// is one of the persistent keys of AddonData, so no string is created
+double getOption(const Napi::Value options, const Napi::Value key, double fallback);
+
 }
 
 #endif
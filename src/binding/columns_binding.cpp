@@ -0,0 +1,81 @@
+extern "C" {
+#include "columns.h"
+}
+
+#include "columns_binding.h"
+
+#include <napi.h>
+
+namespace ColumnsBinding {
+
+// columnStats(values) returns {count, min, max, sum}
+static Napi::Value columnStats(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  Napi::Int16Array values = info[0].As<Napi::Int16Array>();
+
+  struct column_stats stats;
+  column_stats(values.Data(), values.ElementLength(), &stats);
+
+  Napi::Object returnObject = Napi::Object::New(env);
+  returnObject.Set(Napi::String::New(env, "count"), Napi::Number::New(env, stats.count));
+  returnObject.Set(Napi::String::New(env, "min"), Napi::Number::New(env, stats.min));
+  returnObject.Set(Napi::String::New(env, "max"), Napi::Number::New(env, stats.max));
+  returnObject.Set(Napi::String::New(env, "sum"), Napi::Number::New(env, stats.sum));
+  return returnObject;
+}
+
+// columnCountRange(values, lo, hi) returns the number of lo <= value <= hi
+static Napi::Value columnCountRange(const Napi::CallbackInfo &info) {
+  Napi::Int16Array values = info[0].As<Napi::Int16Array>();
+  int16_t lo = info[1].As<Napi::Number>().Int32Value();
+  int16_t hi = info[2].As<Napi::Number>().Int32Value();
+  return Napi::Number::New(info.Env(),
+    column_count_range(values.Data(), values.ElementLength(), lo, hi));
+}
+
+// columnFilterRange(values, lo, hi) returns a Uint8Array mask of lo <= value <= hi
+static Napi::Value columnFilterRange(const Napi::CallbackInfo &info) {
+  Napi::Int16Array values = info[0].As<Napi::Int16Array>();
+  int16_t lo = info[1].As<Napi::Number>().Int32Value();
+  int16_t hi = info[2].As<Napi::Number>().Int32Value();
+  Napi::Uint8Array mask = Napi::Uint8Array::New(info.Env(), values.ElementLength());
+  column_filter_range(values.Data(), values.ElementLength(), lo, hi, mask.Data());
+  return mask;
+}
+
+// columnCrossings(values, threshold) returns the number of upward crossings
+static Napi::Value columnCrossings(const Napi::CallbackInfo &info) {
+  Napi::Int16Array values = info[0].As<Napi::Int16Array>();
+  int16_t threshold = info[1].As<Napi::Number>().Int32Value();
+  return Napi::Number::New(info.Env(),
+    column_crossings(values.Data(), values.ElementLength(), threshold));
+}
+
+// dewPoint(temp, hum) returns an Int16Array of dew points
+static Napi::Value dewPoint(const Napi::CallbackInfo &info) {
+  Napi::Int16Array temp = info[0].As<Napi::Int16Array>();
+  Napi::Int16Array hum = info[1].As<Napi::Int16Array>();
+  size_t n = temp.ElementLength() < hum.ElementLength()
+    ? temp.ElementLength() : hum.ElementLength();
+  Napi::Int16Array out = Napi::Int16Array::New(info.Env(), n);
+  column_dew_point(temp.Data(), hum.Data(), n, out.Data());
+  return out;
+}
+
+Napi::Object Init(Napi::Env env, Napi::Object exports) {
+  exports.Set(Napi::String::New(env, "columnStats"),
+              Napi::Function::New(env, columnStats));
+  exports.Set(Napi::String::New(env, "columnCountRange"),
+              Napi::Function::New(env, columnCountRange));
+  exports.Set(Napi::String::New(env, "columnFilterRange"),
+              Napi::Function::New(env, columnFilterRange));
+  exports.Set(Napi::String::New(env, "columnCrossings"),
+              Napi::Function::New(env, columnCrossings));
+  exports.Set(Napi::String::New(env, "dewPoint"),
+              Napi::Function::New(env, dewPoint));
+  exports.Set(Napi::String::New(env, "columnKernels"),
+              Napi::String::New(env, columns_isa()));
+  return exports;
+}
+
+}
@@ -0,0 +1,14 @@
+#ifndef COLUMNS_BINDING
+#define COLUMNS_BINDING
+
+#include <napi.h>
+
+namespace ColumnsBinding {
+
+// Adds the columnar history kernels to exports; all of them work on
+// Int16Arrays of tenths, as transmitted by the sensor
+Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+}
+
+#endif
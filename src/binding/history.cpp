@@ -0,0 +1,77 @@
+#include "history.h"
+
+#include <napi.h>
+
+#include <cmath>
+#include <cstdint>
+
+// Default amount of memory for a ring, enough for several months
+// of one-minute readings
+#define HISTORY_DEFAULT_BYTES (256 * 1024)
+
+Napi::Object History::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function constructor = DefineClass(env, "History", {
+    InstanceMethod("append", &History::append),
+    InstanceMethod("query", &History::query),
+    InstanceMethod("count", &History::count),
+    InstanceMethod("memory", &History::memory),
+  });
+  exports.Set(Napi::String::New(env, "History"), constructor);
+  return exports;
+}
+
+History::History(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<History>(info), ring(nullptr) {
+  size_t bytes = HISTORY_DEFAULT_BYTES;
+  if (info.Length() > 0 && info[0].IsNumber()) {
+    bytes = info[0].As<Napi::Number>().Int64Value();
+  }
+
+  ring = ring_create(bytes);
+  if (!ring) {
+    Napi::RangeError::New(info.Env(), "Could not allocate history ring")
+      .ThrowAsJavaScriptException();
+  }
+}
+
+History::~History() {
+  ring_destroy(ring);
+}
+
+Napi::Value History::append(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int64_t time = info[0].As<Napi::Number>().Int64Value();
+  double temperature = info[1].As<Napi::Number>();
+  double humidity = info[2].As<Napi::Number>();
+  int quality = info.Length() > 3 ? info[3].As<Napi::Number>().Int32Value() : 0;
+
+  // Readings are kept in tenths, as transmitted by the sensor
+  int err = ring_append(ring, time,
+                        (int16_t)std::lround(temperature * 10),
+                        (int16_t)std::lround(humidity * 10),
+                        (uint8_t)quality);
+  return Napi::Number::New(env, err);
+}
+
+Napi::Value History::query(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  int64_t from = info[0].As<Napi::Number>().Int64Value();
+  int64_t to = info.Length() > 1 ? info[1].As<Napi::Number>().Int64Value()
+                                 : INT64_MAX;
+
+  // Decode straight into the backing store of the returned array
+  size_t bound = ring_count_range(ring, from, to);
+  Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env,
+    bound * RING_VALUES_PER_READING * sizeof(double));
+  size_t n = ring_query(ring, from, to,
+                        static_cast<double *>(buffer.Data()), bound);
+  return Napi::Float64Array::New(env, n * RING_VALUES_PER_READING, buffer, 0);
+}
+
+Napi::Value History::count(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), ring ? ring->count : 0);
+}
+
+Napi::Value History::memory(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), ring_memory(ring));
+}
@@ -0,0 +1,31 @@
+#ifndef HISTORY
+#define HISTORY
+
+extern "C" {
+#include "ring.h"
+}
+
+#include <napi.h>
+
+// Javascript wrapper around the compressed in-memory ring of readings
+class History : public Napi::ObjectWrap<History> {
+ public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  History(const Napi::CallbackInfo &info);
+  ~History();
+
+ private:
+  // append(time, temp, hum[, quality]), time in seconds
+  Napi::Value append(const Napi::CallbackInfo &info);
+
+  // query(from, to) returns a Float64Array of [time, temp, hum, quality]
+  Napi::Value query(const Napi::CallbackInfo &info);
+
+  Napi::Value count(const Napi::CallbackInfo &info);
+  Napi::Value memory(const Napi::CallbackInfo &info);
+
+  struct ring *ring;
+};
+
+#endif
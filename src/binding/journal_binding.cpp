@@ -0,0 +1,105 @@
+extern "C" {
+#include "dht.h"
+#include "ring.h"
+}
+
+#include "binding_utils.h"
+#include "journal_binding.h"
+
+#include <napi.h>
+
+#include <cmath>
+#include <string>
+
+// Cursor for writing replayed records into a Float64Array
+struct ReplayCursor {
+  double *out;
+  size_t n;
+  size_t max;
+};
+
+static void replayRecord(void *ctx, const struct journal_record *record) {
+  ReplayCursor *cursor = static_cast<ReplayCursor *>(ctx);
+  if (cursor->n == cursor->max) {
+    return;
+  }
+  double *reading = cursor->out + cursor->n * RING_VALUES_PER_READING;
+  reading[0] = (double)record->ts;
+  reading[1] = record->temp / 10.0;
+  reading[2] = record->hum / 10.0;
+  reading[3] = record->quality;
+  cursor->n++;
+}
+
+Napi::Object Journal::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function constructor = DefineClass(env, "Journal", {
+    InstanceMethod("append", &Journal::append),
+    InstanceMethod("appendTenths", &Journal::appendTenths),
+    InstanceMethod("commit", &Journal::commit),
+    InstanceMethod("close", &Journal::close),
+    InstanceMethod("replay", &Journal::replay),
+  });
+  exports.Set(Napi::String::New(env, "Journal"), constructor);
+  return exports;
+}
+
+Journal::Journal(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<Journal>(info) {
+  journal.fd = -1;
+  std::string path = info[0].As<Napi::String>();
+  unsigned int batchRecords = info.Length() > 1 && info[1].IsNumber()
+    ? info[1].As<Napi::Number>().Uint32Value() : 0;
+  unsigned int batchSeconds = info.Length() > 2 && info[2].IsNumber()
+    ? info[2].As<Napi::Number>().Uint32Value() : 0;
+
+  if (journal_open(&journal, path.c_str(), batchRecords, batchSeconds)) {
+    Napi::Error::New(info.Env(), "Could not open journal " + path)
+      .ThrowAsJavaScriptException();
+  }
+}
+
+Journal::~Journal() {
+  if (journal.fd >= 0) {
+    journal_close(&journal);
+  }
+}
+
+Napi::Value Journal::append(const Napi::CallbackInfo &info) {
+  struct journal_record record = {};
+  record.ts = info[0].As<Napi::Number>().Int64Value();
+  record.temp = (int16_t)std::lround(info[1].As<Napi::Number>().DoubleValue() * 10);
+  record.hum = (int16_t)std::lround(info[2].As<Napi::Number>().DoubleValue() * 10);
+  record.quality = info.Length() > 3 ? info[3].As<Napi::Number>().Uint32Value() : 0;
+  return Napi::Number::New(info.Env(), journal_append(&journal, &record));
+}
+
+Napi::Value Journal::appendTenths(const Napi::CallbackInfo &info) {
+  struct journal_record record = {};
+  record.ts = info[0].As<Napi::Number>().Int64Value();
+  record.temp = (int16_t)info[1].As<Napi::Number>().Int32Value();
+  record.hum = (int16_t)info[2].As<Napi::Number>().Int32Value();
+  record.quality = info.Length() > 3 ? info[3].As<Napi::Number>().Uint32Value() : 0;
+  return Napi::Number::New(info.Env(), journal_append(&journal, &record));
+}
+
+Napi::Value Journal::commit(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), journal_commit(&journal));
+}
+
+Napi::Value Journal::close(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), journal_close(&journal));
+}
+
+Napi::Value Journal::replay(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+
+  // Committed record count is known up front, so one pass over the map fills it
+  size_t max = journal.fd >= 0 ? journal.records : 0;
+  Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env,
+    max * RING_VALUES_PER_READING * sizeof(double));
+  ReplayCursor cursor = { static_cast<double *>(buffer.Data()), 0, max };
+  if (max && journal_replay(&journal, replayRecord, &cursor) < 0) {
+    return BindingUtils::errFactory(env, ERROR_DRIVER, "Could not replay journal");
+  }
+  return Napi::Float64Array::New(env, cursor.n * RING_VALUES_PER_READING, buffer, 0);
+}
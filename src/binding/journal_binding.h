@@ -0,0 +1,38 @@
+#ifndef JOURNAL_BINDING
+#define JOURNAL_BINDING
+
+extern "C" {
+#include "journal.h"
+}
+
+#include <napi.h>
+
+// Javascript wrapper around the append-only on-disk reading journal
+class Journal : public Napi::ObjectWrap<Journal> {
+ public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  // new Journal(path[, batchRecords[, batchSeconds]])
+  Journal(const Napi::CallbackInfo &info);
+  ~Journal();
+
+ private:
+  // append(time, temp, hum[, quality]), time in seconds
+  Napi::Value append(const Napi::CallbackInfo &info);
+
+  // appendTenths(time, tempTenths, humTenths[, quality]), the integers a
+  // reading came with, stored as they are
+  Napi::Value appendTenths(const Napi::CallbackInfo &info);
+
+  // Commit pending records now
+  Napi::Value commit(const Napi::CallbackInfo &info);
+  Napi::Value close(const Napi::CallbackInfo &info);
+
+  // replay() returns a Float64Array of [time, temp, hum, quality]
+  // for every committed record
+  Napi::Value replay(const Napi::CallbackInfo &info);
+
+  struct journal journal;
+};
+
+#endif
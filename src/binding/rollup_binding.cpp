@@ -0,0 +1,109 @@
+extern "C" {
+#include "dht.h"
+#include "rollup.h"
+}
+
+#include "binding_utils.h"
+#include "rollup_binding.h"
+
+#include <napi.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// Parses a resolution name; returns ROLLUP_NUM_RESOLUTIONS if unknown
+static enum rollup_resolution parseResolution(const Napi::Value &value) {
+  std::string name = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+  if (name == "minute") return ROLLUP_MINUTE;
+  if (name == "hour") return ROLLUP_HOUR;
+  if (name == "day") return ROLLUP_DAY;
+  return ROLLUP_NUM_RESOLUTIONS;
+}
+
+Napi::Object Rollup::Init(Napi::Env env, Napi::Object exports) {
+  Napi::Function constructor = DefineClass(env, "Rollup", {
+    InstanceMethod("add", &Rollup::add),
+    InstanceMethod("aggregate", &Rollup::aggregate),
+    InstanceMethod("series", &Rollup::series),
+  });
+  exports.Set(Napi::String::New(env, "Rollup"), constructor);
+  return exports;
+}
+
+Rollup::Rollup(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<Rollup>(info), rollup() {
+  static const char *keys[ROLLUP_NUM_RESOLUTIONS] = { "minutes", "hours", "days" };
+  size_t retention[ROLLUP_NUM_RESOLUTIONS] = {};
+
+  if (info.Length() > 0 && info[0].IsObject()) {
+    Napi::Object options = info[0].As<Napi::Object>();
+    for (int i = 0; i < ROLLUP_NUM_RESOLUTIONS; i++) {
+      if (options.Get(keys[i]).IsNumber()) {
+        retention[i] = options.Get(keys[i]).As<Napi::Number>().Uint32Value();
+      }
+    }
+  }
+
+  if (rollup_init(&rollup, retention)) {
+    // The rollup is left empty, so the destructor has nothing to free
+    Napi::RangeError::New(info.Env(), "Could not allocate rollup buckets")
+      .ThrowAsJavaScriptException();
+  }
+}
+
+Rollup::~Rollup() {
+  rollup_free(&rollup);
+}
+
+Napi::Value Rollup::add(const Napi::CallbackInfo &info) {
+  int64_t time = info[0].As<Napi::Number>().Int64Value();
+  double temperature = info[1].As<Napi::Number>();
+  double humidity = info[2].As<Napi::Number>();
+  rollup_add(&rollup, time,
+             (int16_t)std::lround(temperature * 10),
+             (int16_t)std::lround(humidity * 10));
+  return info.Env().Undefined();
+}
+
+Napi::Value Rollup::aggregate(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  enum rollup_resolution res = parseResolution(info[0]);
+  int64_t from = info[1].As<Napi::Number>().Int64Value();
+  int64_t to = info.Length() > 2 ? info[2].As<Napi::Number>().Int64Value()
+                                 : INT64_MAX;
+
+  struct rollup_aggregate agg;
+  if (rollup_aggregate(&rollup, res, from, to, &agg)) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Unknown resolution");
+  }
+
+  Napi::Object returnObject = Napi::Object::New(env);
+  returnObject.Set(Napi::String::New(env, "count"), Napi::Number::New(env, agg.count));
+  returnObject.Set(Napi::String::New(env, "tempMin"), Napi::Number::New(env, agg.temp_min));
+  returnObject.Set(Napi::String::New(env, "tempMax"), Napi::Number::New(env, agg.temp_max));
+  returnObject.Set(Napi::String::New(env, "tempMean"), Napi::Number::New(env, agg.temp_mean));
+  returnObject.Set(Napi::String::New(env, "humMin"), Napi::Number::New(env, agg.hum_min));
+  returnObject.Set(Napi::String::New(env, "humMax"), Napi::Number::New(env, agg.hum_max));
+  returnObject.Set(Napi::String::New(env, "humMean"), Napi::Number::New(env, agg.hum_mean));
+  return returnObject;
+}
+
+Napi::Value Rollup::series(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  enum rollup_resolution res = parseResolution(info[0]);
+  if (res == ROLLUP_NUM_RESOLUTIONS) {
+    return BindingUtils::errFactory(env, ERROR_INVAL, "Unknown resolution");
+  }
+  int64_t from = info[1].As<Napi::Number>().Int64Value();
+  int64_t to = info.Length() > 2 ? info[2].As<Napi::Number>().Int64Value()
+                                 : INT64_MAX;
+
+  // At most every retained bucket can be in range
+  size_t max = rollup.levels[res].nbuckets;
+  Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env,
+    max * ROLLUP_VALUES_PER_BUCKET * sizeof(double));
+  size_t n = rollup_series(&rollup, res, from, to,
+                           static_cast<double *>(buffer.Data()), max);
+  return Napi::Float64Array::New(env, n * ROLLUP_VALUES_PER_BUCKET, buffer, 0);
+}
@@ -0,0 +1,34 @@
+#ifndef ROLLUP_BINDING
+#define ROLLUP_BINDING
+
+extern "C" {
+#include "rollup.h"
+}
+
+#include <napi.h>
+
+// Javascript wrapper around the minute/hour/day rollup engine
+class Rollup : public Napi::ObjectWrap<Rollup> {
+ public:
+  static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+  // new Rollup([{minutes, hours, days}]), numbers of buckets to retain
+  Rollup(const Napi::CallbackInfo &info);
+  ~Rollup();
+
+ private:
+  // add(time, temp, hum), time in seconds
+  Napi::Value add(const Napi::CallbackInfo &info);
+
+  // aggregate(resolution, from, to) returns {count, tempMin, tempMax,
+  // tempMean, humMin, humMax, humMean}; resolution is 'minute', 'hour' or 'day'
+  Napi::Value aggregate(const Napi::CallbackInfo &info);
+
+  // series(resolution, from, to) returns a Float64Array of [start, count,
+  // tempMin, tempMax, tempMean, humMin, humMax, humMean] per bucket
+  Napi::Value series(const Napi::CallbackInfo &info);
+
+  struct rollup rollup;
+};
+
+#endif
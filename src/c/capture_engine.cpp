@@ -0,0 +1,15 @@
+#include "capture_engine.hpp"
+
+#include <cstddef>
+#include <utility>
+
+// Every GPIO pin gets its own copy of the loops; they are a few dozen bytes
+// each, and the table is built at compile time
+using AllPins = dht::Pollers<std::make_index_sequence<NUM_PINS>>;
+
+extern "C" const struct DHT_pollers *DHT_pollers_for(int pin) {
+  if (pin < 0 || pin >= NUM_PINS) {
+    return NULL;
+  }
+  return &AllPins::table[pin];
+}
@@ -0,0 +1,34 @@
+#ifndef CAPTURE_ENGINE
+#define CAPTURE_ENGINE
+
+#include "bcm2835.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Polling loops of the capture, compiled by capture_engine.cpp once for each
+// pin from the templates in capture_engine.hpp, so that the pin's register
+// and bit are constants in the loop rather than values looked up per poll
+
+struct DHT_pollers {
+  // Polls for timeout_cycles until the pin changes to level, then counts the
+  // polls it stays there into held; returns 0, or ERROR_TIME if the level
+  // never came
+  int (*level_or_error)(const struct bcm2835_ctx *ctx, uint8_t level,
+                        uint32_t timeout_cycles, int *held);
+
+  // Counts the polls the pin stays at level, up to limit
+  int (*level_cycles)(const struct bcm2835_ctx *ctx, uint8_t level, int limit);
+};
+
+// Loops for pin, or NULL if pin isn't a GPIO pin
+const struct DHT_pollers *DHT_pollers_for(int pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef CAPTURE_ENGINE_HPP
+#define CAPTURE_ENGINE_HPP
+
+extern "C" {
+#include "capture_engine.h"
+#include "dht.h"
+}
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Capture loops specialised at compile time on the pin
+//
+// With the pin a template argument, the offset of its GPLEV register from
+// the mapping and its bit are constants, so once inlined a poll is a load,
+// an and with an immediate and a compare. Board differences, i.e. the
+// peripheral base and the Pi 4 pull-up registers, only matter when the
+// driver is opened and pull-ups set, not while polling, so they stay with
+// the bcm2835 context rather than in a template argument.
+
+namespace dht {
+
+template <unsigned Pin>
+class Line {
+  static_assert(Pin < NUM_PINS, "not a BCM2835 GPIO pin");
+
+ public:
+  static constexpr unsigned word = BCM2835_GPLEV0 / 4 + Pin / 32;
+  static constexpr uint32_t mask = 1u << (Pin % 32);
+
+  explicit Line(const struct bcm2835_ctx *ctx)
+    : ctx(ctx), lev(ctx->gpio + word) {
+  }
+
+  // Whether the pin is at level, HIGH or LOW; built against fake-gpio.c
+  // (DHT_SIMULATOR), every poll goes to its script instead
+  bool is(uint8_t level) const {
+#ifdef DHT_SIMULATOR
+    (void)lev;
+    return bcm2835_ctx_gpio_lev(ctx, Pin) == level;
+#else
+    (void)ctx;
+    return (*lev & mask) == (level ? mask : 0);
+#endif
+  }
+
+ private:
+  const struct bcm2835_ctx *ctx;
+  volatile uint32_t *lev;
+};
+
+template <unsigned Pin>
+int levelOrError(const struct bcm2835_ctx *ctx, uint8_t level,
+                 uint32_t timeoutCycles, int *held) {
+  Line<Pin> line(ctx);
+  for (uint32_t i = 0; i < timeoutCycles; i++) {
+    if (line.is(level)) {
+      int count = 0;
+      while (line.is(level)) {
+        ++count;
+      }
+      *held = count;
+      return 0;
+    }
+  }
+  return ERROR_TIME;
+}
+
+template <unsigned Pin>
+int levelCycles(const struct bcm2835_ctx *ctx, uint8_t level, int limit) {
+  Line<Pin> line(ctx);
+  int count = 0;
+  while (line.is(level) && count < limit) {
+    ++count;
+  }
+  return count;
+}
+
+// Table of the loops for each of Pins, indexed by pin
+template <class Pins>
+struct Pollers;
+
+template <std::size_t... Pins>
+struct Pollers<std::index_sequence<Pins...>> {
+  static constexpr struct DHT_pollers table[sizeof...(Pins)] = {
+    {levelOrError<Pins>, levelCycles<Pins>}...
+  };
+};
+
+template <std::size_t... Pins>
+constexpr struct DHT_pollers Pollers<std::index_sequence<Pins...>>::table[];
+
+}
+
+#endif
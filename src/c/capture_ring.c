@@ -0,0 +1,72 @@
+#include "capture_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+_Static_assert(sizeof(struct capture_slot) == 232, "capture_slot layout");
+_Static_assert(sizeof(struct capture_ring) == 16, "capture_ring layout");
+
+struct capture_ring *capture_ring_create(uint32_t slots) {
+  if (slots == 0 || slots > CAPTURE_RING_MAX_SLOTS) {
+    return NULL;
+  }
+  struct capture_ring *ring =
+    calloc(1, sizeof(struct capture_ring) + slots * sizeof(struct capture_slot));
+  if (!ring) {
+    return NULL;
+  }
+  ring->capacity = slots;
+  ring->slot_size = sizeof(struct capture_slot);
+  return ring;
+}
+
+void capture_ring_destroy(struct capture_ring *ring) {
+  free(ring);
+}
+
+size_t capture_ring_bytes(const struct capture_ring *ring) {
+  return sizeof(*ring) + ring->capacity * sizeof(struct capture_slot);
+}
+
+static uint16_t clamp16(int cycles) {
+  return cycles < 0 ? 0 : cycles > UINT16_MAX ? UINT16_MAX : cycles;
+}
+
+void capture_ring_push(struct capture_ring *ring, const struct DHT_attempt *attempt) {
+  if (!ring || !attempt) {
+    return;
+  }
+  struct capture_slot *slot = &ring->slots[ring->head % ring->capacity];
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  slot->time_ms = now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+  slot->seq = ring->head;
+  slot->bits_ns = attempt->bits_ns > UINT32_MAX ? UINT32_MAX : attempt->bits_ns;
+  slot->pin = attempt->pin;
+  slot->attempt = attempt->attempt > UINT8_MAX ? UINT8_MAX : attempt->attempt;
+  slot->stage = attempt->stage;
+  // A range failure is only decided once the checksum matched
+  slot->parity_ok = attempt->stage == DHT_STAGE_OK || attempt->stage == DHT_STAGE_RANGE;
+  slot->ack_low = clamp16(attempt->ack_low_cycles);
+  slot->ack_high = clamp16(attempt->ack_high_cycles);
+
+  // Same decision as DHT_process_data: a 1 holds the line high for longer
+  // than the low before it
+  int captured = attempt->data != NULL;
+  for (int i = 0; i < NUM_BITS; i++) {
+    int low = attempt->cycles[i*2], high = attempt->cycles[i*2+1];
+    slot->cycles[i*2] = clamp16(low);
+    slot->cycles[i*2+1] = clamp16(high);
+    slot->bits[i] = captured ? high > low : CAPTURE_BIT_NONE;
+  }
+  if (captured) {
+    memcpy(slot->data, attempt->data, NUM_BYTES);
+  } else {
+    memset(slot->data, 0, NUM_BYTES);
+  }
+
+  // Readers on other threads only see the slot once it's complete
+  __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
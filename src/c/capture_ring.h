@@ -0,0 +1,56 @@
+#ifndef CAPTURE_RING
+#define CAPTURE_RING
+
+#include "dht.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed ring of the raw timings of the last attempts on a pin
+//
+// The ring is one flat allocation with a layout that doesn't depend on the
+// compiler, so it can be handed out as is, e.g. to JS as an ArrayBuffer read
+// through typed arrays. Slots are reused oldest first and nothing is
+// allocated once the ring is created. head counts every attempt pushed and
+// is only advanced once the slot it covers is complete; the newest attempt
+// is in slots[(head - 1) % capacity].
+
+#define CAPTURE_RING_SLOTS 16     // Default number of slots
+#define CAPTURE_RING_MAX_SLOTS 1024
+#define CAPTURE_BIT_NONE 0xFF     // Decision of a bit that wasn't captured
+
+struct capture_slot {
+  double time_ms;                 // Wall clock time of the attempt, ms
+  uint32_t seq;                   // Value of head when pushed, from 0
+  uint32_t bits_ns;               // Time taken by the 40 bits, if captured
+  uint8_t pin;
+  uint8_t attempt;                // 0 for the first attempt of a read
+  uint8_t stage;                  // enum DHT_stage
+  uint8_t parity_ok;              // Checksum matched, even if out of range
+  uint16_t ack_low;               // Response cycles
+  uint16_t ack_high;
+  uint16_t cycles[NUM_BITS * 2];  // Low then high cycles of each bit
+  uint8_t bits[NUM_BITS];         // Value decided for each bit
+  uint8_t data[NUM_BYTES];        // As decoded
+  uint8_t reserved[3];
+};
+
+struct capture_ring {
+  uint32_t capacity;              // Number of slots
+  uint32_t slot_size;             // sizeof(struct capture_slot)
+  uint32_t head;                  // Number of attempts pushed
+  uint32_t reserved;
+  struct capture_slot slots[];
+};
+
+// Allocate a ring of slots entries, at most CAPTURE_RING_MAX_SLOTS
+struct capture_ring *capture_ring_create(uint32_t slots);
+void capture_ring_destroy(struct capture_ring *ring);
+
+// Size of the whole ring, header included
+size_t capture_ring_bytes(const struct capture_ring *ring);
+
+// Copy an attempt into the oldest slot
+void capture_ring_push(struct capture_ring *ring, const struct DHT_attempt *attempt);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CLI
+#define CLI
+
+// Subcommands of dht-cli; each takes argv with the subcommand name at argv[0]
+
+// dht-cli history [-t threshold] FILE
+// Analyses a reading journal: overall and daily extremes, threshold
+// crossings and dew point
+int cli_history(int argc, char **argv);
+
+// dht-cli analyze [-j threads] FILE...
+// Decodes recordings from many devices on a pool of threads: success per
+// decoder, margin distribution, failures by bit and a summary per device
+int cli_analyze(int argc, char **argv);
+
+// dht-cli vcd [-a] [-n count] TRACE [OUT]
+// Writes the failed attempts of a recording, or with -a all of them, as a
+// Value Change Dump to OUT or stdout; at most count attempts, by default 64
+int cli_vcd(int argc, char **argv);
+
+// dht-cli --replay FILE
+// Runs every decoder over the frames of a recording made with --record, and
+// compares their results with each other and with what was recorded
+int cli_replay(const char *path);
+
+#endif
@@ -0,0 +1,124 @@
+#include "cli.h"
+
+#include "columns.h"
+#include "dht.h"
+#include "journal.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SECONDS_PER_DAY 86400
+
+static void push_record(void *ctx, const struct journal_record *record) {
+  columns_push(ctx, record->ts, record->temp, record->hum);
+}
+
+// Loads every committed record of a journal file into columns
+static int load_journal(const char *path, struct columns *columns) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return ERROR_INVAL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size == 0) {
+    fprintf(stderr, "%s: empty or unreadable journal\n", path);
+    close(fd);
+    return ERROR_INVAL;
+  }
+  uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror(path);
+    return ERROR_INVAL;
+  }
+
+  // Count first, so the columns are allocated exactly once
+  uint64_t records = journal_scan(data, st.st_size, NULL, NULL, NULL, NULL);
+  int err = columns_init(columns, records);
+  if (!err) {
+    journal_scan(data, st.st_size, push_record, columns, NULL, NULL);
+  }
+  munmap(data, st.st_size);
+  return err;
+}
+
+static void print_stats(const char *name, const int16_t *col, size_t n,
+                        const char *unit) {
+  struct column_stats stats;
+  column_stats(col, n, &stats);
+  printf("%-12s min %6.1f%s  max %6.1f%s  mean %6.1f%s\n", name,
+         stats.min / 10.0, unit, stats.max / 10.0, unit,
+         stats.sum / 10.0 / stats.count, unit);
+}
+
+int cli_history(int argc, char **argv) {
+  int threshold = 250;  // Tenths of deg C
+
+  int c;
+  while ((c = getopt(argc, argv, "t:")) != -1) {
+    switch (c) {
+      case 't':
+        threshold = (int)(atof(optarg) * 10);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-t threshold] FILE\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "Usage: %s [-t threshold] FILE\n", argv[0]);
+    return 1;
+  }
+
+  struct columns columns;
+  if (load_journal(argv[optind], &columns) || columns.n == 0) {
+    return 1;
+  }
+  size_t n = columns.n;
+  printf("%zu readings, kernels: %s\n\n", n, columns_isa());
+
+  print_stats("Temperature", columns.temp, n, " C");
+  print_stats("Humidity", columns.hum, n, " %");
+
+  int16_t *dew_point = malloc(n * sizeof(int16_t));
+  if (dew_point) {
+    column_dew_point(columns.temp, columns.hum, n, dew_point);
+    print_stats("Dew point", dew_point, n, " C");
+    free(dew_point);
+  }
+
+  printf("\nRose through %.1f C %zu times; %zu readings at or above\n",
+         threshold / 10.0, column_crossings(columns.temp, n, threshold),
+         column_count_range(columns.temp, n, threshold, INT16_MAX));
+
+  // Readings are in time order, so each UTC day is a contiguous slice
+  printf("\n%-10s  %7s %7s  %7s %7s\n", "Day", "Min C", "Max C", "Min %", "Max %");
+  for (size_t start = 0; start < n; ) {
+    int64_t day = columns.ts[start] / SECONDS_PER_DAY;
+    size_t end = start;
+    while (end < n && columns.ts[end] / SECONDS_PER_DAY == day) {
+      end++;
+    }
+
+    struct column_stats temp, hum;
+    column_stats(columns.temp + start, end - start, &temp);
+    column_stats(columns.hum + start, end - start, &hum);
+
+    char date[16];
+    time_t t = day * SECONDS_PER_DAY;
+    strftime(date, sizeof(date), "%Y-%m-%d", gmtime(&t));
+    printf("%-10s  %7.1f %7.1f  %7.1f %7.1f\n", date,
+           temp.min / 10.0, temp.max / 10.0, hum.min / 10.0, hum.max / 10.0);
+    start = end;
+  }
+
+  columns_free(&columns);
+  return 0;
+}
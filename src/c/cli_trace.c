@@ -0,0 +1,539 @@
+#include "cli.h"
+
+#include "decode.h"
+#include "dht.h"
+#include "model.h"
+#include "trace.h"
+#include "vcd.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_STAGES (DHT_STAGE_RANGE + 1)
+#define CHUNK_RECORDS 16384   // Records handed to a thread at a time
+#define MARGIN_BUCKETS 11     // 10% wide, the last for 100% and over
+#define MAX_THREADS 256
+
+static const struct {
+  const char *name;
+  DHT_decoder decode;
+} decoders[] = {
+  {"compare", DHT_process_data},
+  {"median", DHT_process_data_median},
+};
+
+#define NUM_DECODERS (sizeof(decoders) / sizeof(decoders[0]))
+
+// Decodes a captured frame again and range-checks it against the model it
+// was recorded from, like the read path; returns the enum DHT_stage
+static int redecode(DHT_decoder decode, const struct trace_record *record,
+                    const int *cycles, uint8_t *data) {
+  const struct DHT_model_info *model = DHT_model_info(record->model);
+  int16_t hum, temp;
+  if (decode(cycles, data)) {
+    return DHT_STAGE_PARITY;
+  }
+  if (DHT_model_convert(model ? model : DHT_model_info(DHT_MODEL_DHT22),
+                        data, &hum, &temp)) {
+    return DHT_STAGE_RANGE;
+  }
+  return DHT_STAGE_OK;
+}
+
+// Whether the record holds all 40 bits, i.e. they can be decoded again
+static int is_captured(const struct trace_record *record) {
+  return record->stage == DHT_STAGE_OK || record->stage == DHT_STAGE_PARITY ||
+         record->stage == DHT_STAGE_RANGE;
+}
+
+static double now_s(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int cli_replay(const char *path) {
+  struct trace_map map;
+  int err = trace_map(&map, path);
+  if (err) {
+    fprintf(stderr, "%s: %s\n", path,
+            err == ERROR_INVAL ? "not a trace file" : "couldn't map file");
+    return 1;
+  }
+  printf("%zu attempts recorded on %s (%s)\n",
+         map.n, map.header->host, map.header->board);
+
+  size_t stages[NUM_STAGES] = {0};
+  size_t governors[TRACE_GOVERNOR_USERSPACE + 1] = {0};
+  size_t captured = 0, changed = 0, disagree = 0;
+  size_t ok[NUM_DECODERS] = {0};
+  size_t range[NUM_DECODERS] = {0};
+
+  double start = now_s();
+  for (size_t i = 0; i < map.n; i++) {
+    const struct trace_record *record = &map.records[i];
+    if (record->stage < NUM_STAGES) {
+      stages[record->stage]++;
+    }
+    if (record->governor <= TRACE_GOVERNOR_USERSPACE) {
+      governors[record->governor]++;
+    }
+
+    // Only attempts that got all 40 bits can be decoded again
+    if (!is_captured(record)) {
+      continue;
+    }
+    captured++;
+
+    int cycles[NUM_BITS * 2];
+    trace_cycles(record, cycles);
+    uint8_t data[NUM_DECODERS][NUM_BYTES];
+    for (size_t d = 0; d < NUM_DECODERS; d++) {
+      int stage = redecode(decoders[d].decode, record, cycles, data[d]);
+      ok[d] += stage == DHT_STAGE_OK;
+      range[d] += stage == DHT_STAGE_RANGE;
+    }
+
+    // The first decoder is the one used for the recording
+    if (memcmp(data[0], record->data, NUM_BYTES)) {
+      changed++;
+    }
+    for (size_t d = 1; d < NUM_DECODERS; d++) {
+      if (memcmp(data[0], data[d], NUM_BYTES)) {
+        disagree++;
+        break;
+      }
+    }
+  }
+  double elapsed = now_s() - start;
+
+  printf("\nRecorded outcome:\n");
+  for (int s = 0; s < NUM_STAGES; s++) {
+    if (stages[s]) {
+      printf("  %-18s %8zu\n", DHT_stage_str(s), stages[s]);
+    }
+  }
+  printf("\nCPU governor:\n");
+  for (int g = 0; g <= TRACE_GOVERNOR_USERSPACE; g++) {
+    if (governors[g]) {
+      printf("  %-18s %8zu\n", trace_governor_str(g), governors[g]);
+    }
+  }
+
+  printf("\nReplayed %zu captured frames:\n", captured);
+  for (size_t d = 0; d < NUM_DECODERS; d++) {
+    printf("  %-10s ok %8zu  parity %8zu  range %8zu\n",
+           decoders[d].name, ok[d], captured - ok[d] - range[d], range[d]);
+  }
+  if (changed) {
+    printf("  %zu frames decode differently from the recording\n", changed);
+  }
+  printf("  %zu frames where the decoders disagree\n", disagree);
+  printf("  %.0f frames/s\n", elapsed > 0 ? captured / elapsed : 0);
+
+  trace_unmap(&map);
+  return 0;
+}
+
+int cli_vcd(int argc, char **argv) {
+  int all = 0;
+  size_t count = DHT_MAX_ATTEMPTS;
+
+  int c;
+  while ((c = getopt(argc, argv, "an:")) != -1) {
+    switch (c) {
+      case 'a':
+        all = 1;
+        break;
+      case 'n':
+        count = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-a] [-n count] TRACE [OUT]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "Usage: %s [-a] [-n count] TRACE [OUT]\n", argv[0]);
+    return 1;
+  }
+  const char *path = argv[optind];
+  const char *out = optind + 1 < argc ? argv[optind + 1] : "-";
+
+  struct trace_map map;
+  if (trace_map(&map, path)) {
+    fprintf(stderr, "%s: not a trace file\n", path);
+    return 1;
+  }
+  struct trace_record *records = malloc((count ? count : 1) * sizeof(*records));
+  if (!records) {
+    trace_unmap(&map);
+    return 1;
+  }
+
+  // Parity failures are only known once decoded
+  size_t n = 0;
+  for (size_t i = 0; i < map.n && n < count; i++) {
+    int cycles[NUM_BITS * 2];
+    uint8_t data[NUM_BYTES];
+    trace_cycles(&map.records[i], cycles);
+    if (all || map.records[i].stage != DHT_STAGE_OK ||
+        DHT_process_data(cycles, data)) {
+      records[n++] = map.records[i];
+    }
+  }
+  int err = vcd_write(out, records, n);
+  if (err) {
+    fprintf(stderr, "%s: couldn't write VCD\n", out);
+  } else if (strcmp(out, "-")) {
+    printf("Wrote %zu attempts to %s\n", n, out);
+  }
+
+  free(records);
+  trace_unmap(&map);
+  return err ? 1 : 0;
+}
+
+// Totals for one device, i.e. host name, of an analysis
+struct device_summary {
+  uint64_t attempts;
+  uint64_t captured;
+  uint64_t ok;
+  uint64_t parity;
+  uint64_t range;             // Checksum matched, values out of range
+  uint64_t timeouts;
+  uint64_t margin_sum;        // Of the smallest margin of each frame, %
+  uint32_t min_khz;
+  uint32_t max_khz;
+};
+
+// Each thread adds into its own, merged once all threads are done, so
+// threads share nothing but the chunk counter while they work
+struct accumulator {
+  uint64_t attempts;
+  uint64_t stages[NUM_STAGES];
+  uint64_t captured;
+  uint64_t ok[NUM_DECODERS];
+  uint64_t only_ok[NUM_DECODERS];     // Frames no other decoder got
+  uint64_t margins[MARGIN_BUCKETS];
+  uint64_t timeout_bits[NUM_BITS];    // Bit that timed out
+  uint64_t weak_bits[NUM_BITS];       // Bit with the smallest margin, on parity
+  struct device_summary *devices;
+} __attribute__((aligned(64)));
+
+struct chunk {
+  const struct trace_map *map;
+  int device;
+  size_t start;
+  size_t end;
+};
+
+struct analysis {
+  const struct chunk *chunks;
+  size_t nchunks;
+  size_t next;                        // Next chunk to hand out
+  int ndevices;
+};
+
+struct worker {
+  pthread_t thread;
+  struct analysis *analysis;
+  struct accumulator acc;
+};
+
+// Smallest margin between a bit's high and its low, as % of the low
+static int smallest_margin(const int *cycles, int *bit) {
+  int smallest = INT32_MAX;
+  *bit = 0;
+  for (int i = 0; i < NUM_BITS; i++) {
+    int low = cycles[i*2] ? cycles[i*2] : 1;
+    int margin = abs(cycles[i*2+1] - cycles[i*2]) * 100 / low;
+    if (margin < smallest) {
+      smallest = margin;
+      *bit = i;
+    }
+  }
+  return smallest;
+}
+
+static void analyse_record(struct accumulator *acc, int device,
+                           const struct trace_record *record) {
+  struct device_summary *summary = &acc->devices[device];
+  acc->attempts++;
+  summary->attempts++;
+  if (record->stage < NUM_STAGES) {
+    acc->stages[record->stage]++;
+  }
+  if (record->cpu_khz) {
+    if (!summary->min_khz || record->cpu_khz < summary->min_khz) {
+      summary->min_khz = record->cpu_khz;
+    }
+    if (record->cpu_khz > summary->max_khz) {
+      summary->max_khz = record->cpu_khz;
+    }
+  }
+
+  int cycles[NUM_BITS * 2];
+  trace_cycles(record, cycles);
+  if (record->stage == DHT_STAGE_BITS) {
+    summary->timeouts++;
+    for (int i = 0; i < NUM_BITS * 2; i++) {
+      if (cycles[i] >= TIMEOUT_CYCLES) {
+        acc->timeout_bits[i / 2]++;
+        break;
+      }
+    }
+    return;
+  }
+  if (!is_captured(record)) {
+    summary->timeouts++;
+    return;
+  }
+
+  acc->captured++;
+  summary->captured++;
+  int ok[NUM_DECODERS], nok = 0, outcome = DHT_STAGE_OK;
+  uint8_t data[NUM_BYTES];
+  for (size_t d = 0; d < NUM_DECODERS; d++) {
+    int stage = redecode(decoders[d].decode, record, cycles, data);
+    if (!d) {
+      outcome = stage;      // Of the decoder used for the recording
+    }
+    ok[d] = stage == DHT_STAGE_OK;
+    acc->ok[d] += ok[d];
+    nok += ok[d];
+  }
+  for (size_t d = 0; d < NUM_DECODERS; d++) {
+    acc->only_ok[d] += ok[d] && nok == 1;
+  }
+
+  int bit;
+  int margin = smallest_margin(cycles, &bit);
+  acc->margins[margin / 10 < MARGIN_BUCKETS ? margin / 10 : MARGIN_BUCKETS - 1]++;
+  summary->margin_sum += margin;
+  if (ok[0]) {
+    summary->ok++;
+  } else if (outcome == DHT_STAGE_RANGE) {
+    summary->range++;
+  } else {
+    summary->parity++;
+    acc->weak_bits[bit]++;
+  }
+}
+
+static void *analyse(void *arg) {
+  struct worker *worker = arg;
+  struct analysis *analysis = worker->analysis;
+  for (;;) {
+    size_t i = __atomic_fetch_add(&analysis->next, 1, __ATOMIC_RELAXED);
+    if (i >= analysis->nchunks) {
+      return NULL;
+    }
+    const struct chunk *chunk = &analysis->chunks[i];
+    for (size_t r = chunk->start; r < chunk->end; r++) {
+      analyse_record(&worker->acc, chunk->device, &chunk->map->records[r]);
+    }
+  }
+}
+
+static void merge(struct accumulator *into, const struct accumulator *from,
+                  int ndevices) {
+  // Every field but devices is a uint64_t count
+  uint64_t *dst = (uint64_t *)into;
+  const uint64_t *src = (const uint64_t *)from;
+  for (size_t i = 0; i < offsetof(struct accumulator, devices) / sizeof(uint64_t); i++) {
+    dst[i] += src[i];
+  }
+  for (int d = 0; d < ndevices; d++) {
+    struct device_summary *a = &into->devices[d];
+    const struct device_summary *b = &from->devices[d];
+    a->attempts += b->attempts;
+    a->captured += b->captured;
+    a->ok += b->ok;
+    a->parity += b->parity;
+    a->range += b->range;
+    a->timeouts += b->timeouts;
+    a->margin_sum += b->margin_sum;
+    if (b->min_khz && (!a->min_khz || b->min_khz < a->min_khz)) {
+      a->min_khz = b->min_khz;
+    }
+    if (b->max_khz > a->max_khz) {
+      a->max_khz = b->max_khz;
+    }
+  }
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+  return whole ? 100.0 * part / whole : 0;
+}
+
+static void print_analysis(const struct accumulator *acc,
+                           const struct trace_map *maps, const int *first_file,
+                           int ndevices) {
+  printf("\nRecorded outcome:\n");
+  for (int s = 0; s < NUM_STAGES; s++) {
+    printf("  %-18s %12llu %6.2f%%\n", DHT_stage_str(s),
+           (unsigned long long)acc->stages[s], percent(acc->stages[s], acc->attempts));
+  }
+
+  printf("\nDecoders over %llu captured frames:\n",
+         (unsigned long long)acc->captured);
+  for (size_t d = 0; d < NUM_DECODERS; d++) {
+    printf("  %-10s ok %12llu %6.2f%%, only one ok %llu\n", decoders[d].name,
+           (unsigned long long)acc->ok[d], percent(acc->ok[d], acc->captured),
+           (unsigned long long)acc->only_ok[d]);
+  }
+
+  printf("\nSmallest margin per frame, high vs low as %% of low:\n");
+  for (int b = 0; b < MARGIN_BUCKETS; b++) {
+    char range[16];
+    if (b < MARGIN_BUCKETS - 1) {
+      snprintf(range, sizeof(range), "%d-%d%%", b * 10, b * 10 + 9);
+    } else {
+      snprintf(range, sizeof(range), ">=%d%%", b * 10);
+    }
+    printf("  %-8s %12llu %6.2f%%\n", range,
+           (unsigned long long)acc->margins[b], percent(acc->margins[b], acc->captured));
+  }
+
+  printf("\nFailures by bit:\n  %3s %12s %12s\n", "bit", "timeout", "weakest");
+  for (int i = 0; i < NUM_BITS; i++) {
+    if (acc->timeout_bits[i] || acc->weak_bits[i]) {
+      printf("  %3d %12llu %12llu\n", i, (unsigned long long)acc->timeout_bits[i],
+             (unsigned long long)acc->weak_bits[i]);
+    }
+  }
+
+  printf("\n%-20s %-28s %10s %7s %7s %7s %7s %7s %9s\n", "Device", "Board",
+         "Attempts", "ok%", "parity%", "range%", "lost%", "margin%", "MHz");
+  for (int d = 0; d < ndevices; d++) {
+    const struct device_summary *summary = &acc->devices[d];
+    const struct trace_header *header = maps[first_file[d]].header;
+    printf("%-20.20s %-28.28s %10llu %7.2f %7.2f %7.2f %7.2f %7.1f %4u-%-4u\n",
+           header->host, header->board, (unsigned long long)summary->attempts,
+           percent(summary->ok, summary->attempts),
+           percent(summary->parity, summary->attempts),
+           percent(summary->range, summary->attempts),
+           percent(summary->timeouts, summary->attempts),
+           summary->captured ? (double)summary->margin_sum / summary->captured : 0,
+           summary->min_khz / 1000, summary->max_khz / 1000);
+  }
+}
+
+int cli_analyze(int argc, char **argv) {
+  long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  int c;
+  while ((c = getopt(argc, argv, "j:")) != -1) {
+    switch (c) {
+      case 'j':
+        nthreads = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-j threads] FILE...\n", argv[0]);
+        return 1;
+    }
+  }
+  int nfiles = argc - optind;
+  if (nfiles <= 0) {
+    fprintf(stderr, "Usage: %s [-j threads] FILE...\n", argv[0]);
+    return 1;
+  }
+  if (nthreads < 1) {
+    nthreads = 1;
+  } else if (nthreads > MAX_THREADS) {
+    nthreads = MAX_THREADS;
+  }
+
+  // Files from the same host are one device; first_file holds its header
+  struct trace_map *maps = calloc(nfiles, sizeof(*maps));
+  int *device_of = calloc(nfiles, sizeof(int));
+  int *first_file = calloc(nfiles, sizeof(int));
+  if (!maps || !device_of || !first_file) {
+    return 1;
+  }
+  int ndevices = 0;
+  size_t records = 0, nchunks = 0;
+  for (int f = 0; f < nfiles; f++) {
+    const char *path = argv[optind + f];
+    if (trace_map(&maps[f], path)) {
+      fprintf(stderr, "%s: not a trace file\n", path);
+      return 1;
+    }
+    int d = 0;
+    while (d < ndevices && strncmp(maps[first_file[d]].header->host,
+                                   maps[f].header->host, TRACE_NAME_LEN)) {
+      d++;
+    }
+    if (d == ndevices) {
+      first_file[ndevices++] = f;
+    }
+    device_of[f] = d;
+    records += maps[f].n;
+    nchunks += (maps[f].n + CHUNK_RECORDS - 1) / CHUNK_RECORDS;
+  }
+
+  struct chunk *chunks = calloc(nchunks ? nchunks : 1, sizeof(*chunks));
+  struct worker *workers;
+  if (!chunks || posix_memalign((void **)&workers, 64, nthreads * sizeof(*workers))) {
+    return 1;
+  }
+  size_t n = 0;
+  for (int f = 0; f < nfiles; f++) {
+    for (size_t start = 0; start < maps[f].n; start += CHUNK_RECORDS) {
+      chunks[n].map = &maps[f];
+      chunks[n].device = device_of[f];
+      chunks[n].start = start;
+      chunks[n].end = start + CHUNK_RECORDS < maps[f].n
+                      ? start + CHUNK_RECORDS : maps[f].n;
+      n++;
+    }
+  }
+  struct analysis analysis = {chunks, nchunks, 0, ndevices};
+
+  double start = now_s();
+  for (long t = 0; t < nthreads; t++) {
+    memset(&workers[t].acc, 0, sizeof(workers[t].acc));
+    workers[t].analysis = &analysis;
+    workers[t].acc.devices = calloc(ndevices, sizeof(struct device_summary));
+    if (!workers[t].acc.devices) {
+      return 1;
+    }
+  }
+  // The calling thread is worker 0
+  long started = 1;
+  for (; started < nthreads; started++) {
+    if (pthread_create(&workers[started].thread, NULL, analyse, &workers[started])) {
+      break;
+    }
+  }
+  analyse(&workers[0]);
+  for (long t = 1; t < started; t++) {
+    pthread_join(workers[t].thread, NULL);
+    merge(&workers[0].acc, &workers[t].acc, ndevices);
+  }
+  double elapsed = now_s() - start;
+
+  printf("%zu attempts in %d files from %d devices\n", records, nfiles, ndevices);
+  printf("%ld threads, %.3f s, %.0f attempts/s\n", started, elapsed,
+         elapsed > 0 ? records / elapsed : 0);
+  print_analysis(&workers[0].acc, maps, first_file, ndevices);
+
+  for (long t = 0; t < nthreads; t++) {
+    free(workers[t].acc.devices);
+  }
+  for (int f = 0; f < nfiles; f++) {
+    trace_unmap(&maps[f]);
+  }
+  free(workers);
+  free(chunks);
+  free(first_file);
+  free(device_of);
+  free(maps);
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include "columns.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Benchmark for the columnar kernels against a naive loop over an array of
+// reading structs, the layout the same data has as JS objects
+
+#define NUM_SAMPLES (10 * 1000 * 1000)
+#define REPEATS 20
+
+struct naive_reading {
+  double ts;
+  double temp;
+  double hum;
+};
+
+static double now_s(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double columns_s, double naive_s,
+                   double columns_result, double naive_result) {
+  double columns_rate = NUM_SAMPLES * (double)REPEATS / columns_s;
+  double naive_rate = NUM_SAMPLES * (double)REPEATS / naive_s;
+  printf("%-12s %10.1f M samples/s  naive %8.1f M samples/s  %5.1fx  %s\n",
+         name, columns_rate / 1e6, naive_rate / 1e6, columns_rate / naive_rate,
+         columns_result == naive_result ? "ok" : "MISMATCH");
+}
+
+int main(void) {
+  struct columns columns;
+  struct naive_reading *naive = malloc(NUM_SAMPLES * sizeof(*naive));
+  uint8_t *mask = malloc(NUM_SAMPLES);
+  if (!naive || !mask || columns_init(&columns, NUM_SAMPLES)) {
+    return 1;
+  }
+
+  // Synthetic one-minute readings drifting around 21.5 deg C / 45 %
+  srand(1);
+  int temp = 215, hum = 450;
+  for (int i = 0; i < NUM_SAMPLES; i++) {
+    temp += rand() % 5 - 2;
+    hum += rand() % 5 - 2;
+    if (temp < -400 || temp > 800) temp = 215;
+    if (hum < 0 || hum > 1000) hum = 450;
+    columns_push(&columns, 1577836800 + (int64_t)i * 60, temp, hum);
+    naive[i].ts = columns.ts[i];
+    naive[i].temp = temp / 10.0;
+    naive[i].hum = hum / 10.0;
+  }
+  printf("Kernels: %s, %d samples\n", columns_isa(), NUM_SAMPLES);
+
+  volatile double sink = 0;
+  double start, columns_s, naive_s;
+  double columns_result = 0, naive_result = 0;
+
+  // Aggregate: min, max and mean temperature
+  struct column_stats stats;
+  start = now_s();
+  for (int r = 0; r < REPEATS; r++) {
+    column_stats(columns.temp, columns.n, &stats);
+    sink += stats.sum;
+  }
+  columns_s = now_s() - start;
+  columns_result = stats.min + stats.max + (double)stats.sum;
+  start = now_s();
+  for (int r = 0; r < REPEATS; r++) {
+    double min = 1e9, max = -1e9, sum = 0;
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+      if (naive[i].temp < min) min = naive[i].temp;
+      if (naive[i].temp > max) max = naive[i].temp;
+      sum += naive[i].temp;
+    }
+    naive_result = lround(min * 10) + lround(max * 10) + (double)llround(sum * 10);
+    sink += sum;
+  }
+  naive_s = now_s() - start;
+  report("stats", columns_s, naive_s, columns_result, naive_result);
+
+  // Scan: readings within 18.0-24.0 deg C
+  start = now_s();
+  for (int r = 0; r < REPEATS; r++) {
+    columns_result = column_count_range(columns.temp, columns.n, 180, 240);
+  }
+  columns_s = now_s() - start;
+  start = now_s();
+  for (int r = 0; r < REPEATS; r++) {
+    size_t count = 0;
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+      count += naive[i].temp >= 18.0 && naive[i].temp <= 24.0;
+    }
+    naive_result = count;
+  }
+  naive_s = now_s() - start;
+  report("count range", columns_s, naive_s, columns_result, naive_result);
+
+  // Filter: mask of readings within 40-60 %
+  start = now_s();
+  for (int r = 0; r < REPEATS; r++) {
+    columns_result = column_filter_range(columns.hum, columns.n, 400, 600, mask);
+  }
+  columns_s = now_s() - start;
+  start = now_s();
+  for (int r = 0; r < REPEATS; r++) {
+    size_t count = 0;
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+      mask[i] = naive[i].hum >= 40.0 && naive[i].hum <= 60.0;
+      count += mask[i];
+    }
+    naive_result = count;
+  }
+  naive_s = now_s() - start;
+  report("filter", columns_s, naive_s, columns_result, naive_result);
+
+  // Threshold crossings upwards through 25.0 deg C
+  start = now_s();
+  for (int r = 0; r < REPEATS; r++) {
+    columns_result = column_crossings(columns.temp, columns.n, 250);
+  }
+  columns_s = now_s() - start;
+  start = now_s();
+  for (int r = 0; r < REPEATS; r++) {
+    size_t count = 0;
+    for (int i = 1; i < NUM_SAMPLES; i++) {
+      count += naive[i - 1].temp < 25.0 && naive[i].temp >= 25.0;
+    }
+    naive_result = count;
+  }
+  naive_s = now_s() - start;
+  report("crossings", columns_s, naive_s, columns_result, naive_result);
+
+  free(mask);
+  free(naive);
+  columns_free(&columns);
+  return 0;
+}
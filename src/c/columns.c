@@ -0,0 +1,453 @@
+#include "columns.h"
+
+#include "dht.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(COLUMNS_SCALAR)
+#define COLUMNS_ISA "scalar"
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define COLUMNS_ISA "avx2"
+#define COLUMNS_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define COLUMNS_ISA "sse2"
+#define COLUMNS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define COLUMNS_ISA "neon"
+#define COLUMNS_NEON
+#else
+#define COLUMNS_ISA "scalar"
+#endif
+
+// Vectors accumulated into 32-bit (or, for NEON counts, 16-bit) lanes
+// before they are flushed, so that the lanes cannot overflow
+#define CHUNK_VECTORS 8192
+
+// Magnus formula coefficients for dew point over water
+#define MAGNUS_B 17.62f
+#define MAGNUS_C 243.12f
+
+int columns_init(struct columns *columns, size_t capacity) {
+  if (!columns) {
+    return ERROR_INVAL;
+  }
+  columns->n = 0;
+  columns->capacity = capacity;
+  columns->ts = malloc(capacity * sizeof(int64_t));
+  columns->temp = malloc(capacity * sizeof(int16_t));
+  columns->hum = malloc(capacity * sizeof(int16_t));
+  if (!columns->ts || !columns->temp || !columns->hum) {
+    columns_free(columns);
+    return ERROR_INVAL;
+  }
+  return NO_ERROR;
+}
+
+void columns_free(struct columns *columns) {
+  if (!columns) {
+    return;
+  }
+  free(columns->ts);
+  free(columns->temp);
+  free(columns->hum);
+  columns->ts = NULL;
+  columns->temp = columns->hum = NULL;
+  columns->n = columns->capacity = 0;
+}
+
+int columns_push(struct columns *columns, int64_t ts, int16_t temp, int16_t hum) {
+  if (!columns || columns->n == columns->capacity) {
+    return ERROR_INVAL;
+  }
+  columns->ts[columns->n] = ts;
+  columns->temp[columns->n] = temp;
+  columns->hum[columns->n] = hum;
+  columns->n++;
+  return NO_ERROR;
+}
+
+const char *columns_isa(void) {
+  return COLUMNS_ISA;
+}
+
+// Scalar kernels, used on their own without SIMD and for the tails with it
+
+static void stats_scalar(const int16_t *col, size_t n, struct column_stats *out) {
+  for (size_t i = 0; i < n; i++) {
+    if (col[i] < out->min) out->min = col[i];
+    if (col[i] > out->max) out->max = col[i];
+    out->sum += col[i];
+  }
+  out->count += n;
+}
+
+static size_t count_range_scalar(const int16_t *col, size_t n,
+                                 int16_t lo, int16_t hi) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    count += col[i] >= lo && col[i] <= hi;
+  }
+  return count;
+}
+
+static size_t filter_range_scalar(const int16_t *col, size_t n,
+                                  int16_t lo, int16_t hi, uint8_t *mask) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    mask[i] = col[i] >= lo && col[i] <= hi;
+    count += mask[i];
+  }
+  return count;
+}
+
+// Crossings ending at col[1..n), looking back at col[i - 1]
+static size_t crossings_scalar(const int16_t *col, size_t n, int16_t threshold) {
+  size_t count = 0;
+  for (size_t i = 1; i < n; i++) {
+    count += col[i - 1] < threshold && col[i] >= threshold;
+  }
+  return count;
+}
+
+// Vector kernels: each handles a multiple of the vector width from the start
+// of the column and returns how many elements it covered
+
+#if defined(COLUMNS_AVX2)
+
+static size_t stats_vec(const int16_t *col, size_t n, struct column_stats *out) {
+  __m256i vmin = _mm256_set1_epi16(INT16_MAX);
+  __m256i vmax = _mm256_set1_epi16(INT16_MIN);
+  __m256i ones = _mm256_set1_epi16(1);
+  size_t i = 0;
+
+  while (i + 16 <= n) {
+    __m256i acc = _mm256_setzero_si256();
+    for (size_t v = 0; v < CHUNK_VECTORS && i + 16 <= n; v++, i += 16) {
+      __m256i x = _mm256_loadu_si256((const __m256i *)(col + i));
+      vmin = _mm256_min_epi16(vmin, x);
+      vmax = _mm256_max_epi16(vmax, x);
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, ones));
+    }
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    for (int l = 0; l < 8; l++) {
+      out->sum += lanes[l];
+    }
+  }
+
+  int16_t mins[16], maxs[16];
+  _mm256_storeu_si256((__m256i *)mins, vmin);
+  _mm256_storeu_si256((__m256i *)maxs, vmax);
+  for (int l = 0; l < 16; l++) {
+    if (mins[l] < out->min) out->min = mins[l];
+    if (maxs[l] > out->max) out->max = maxs[l];
+  }
+  out->count += i;
+  return i;
+}
+
+// All-ones lanes where lo <= x <= hi
+static inline __m256i in_range(__m256i x, __m256i lo, __m256i hi) {
+  __m256i out = _mm256_or_si256(_mm256_cmpgt_epi16(lo, x), _mm256_cmpgt_epi16(x, hi));
+  return _mm256_xor_si256(out, _mm256_set1_epi16(-1));
+}
+
+static size_t count_range_vec(const int16_t *col, size_t n,
+                              int16_t lo, int16_t hi, size_t *count) {
+  __m256i vlo = _mm256_set1_epi16(lo), vhi = _mm256_set1_epi16(hi);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(col + i));
+    *count += __builtin_popcount(_mm256_movemask_epi8(in_range(x, vlo, vhi))) / 2;
+  }
+  return i;
+}
+
+static size_t filter_range_vec(const int16_t *col, size_t n, int16_t lo, int16_t hi,
+                               uint8_t *mask, size_t *count) {
+  __m256i vlo = _mm256_set1_epi16(lo), vhi = _mm256_set1_epi16(hi);
+  __m128i one = _mm_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(col + i));
+    __m256i m = in_range(x, vlo, vhi);
+    *count += __builtin_popcount(_mm256_movemask_epi8(m)) / 2;
+    // Narrow the 16-bit lanes to bytes; packs works per 128-bit half
+    __m128i bytes = _mm_packs_epi16(_mm256_castsi256_si128(m),
+                                    _mm256_extracti128_si256(m, 1));
+    _mm_storeu_si128((__m128i *)(mask + i), _mm_and_si128(bytes, one));
+  }
+  return i;
+}
+
+static size_t crossings_vec(const int16_t *col, size_t n, int16_t threshold,
+                            size_t *count) {
+  __m256i t = _mm256_set1_epi16(threshold);
+  size_t i = 1;
+  for (; i + 16 <= n; i += 16) {
+    __m256i prev = _mm256_loadu_si256((const __m256i *)(col + i - 1));
+    __m256i cur = _mm256_loadu_si256((const __m256i *)(col + i));
+    __m256i m = _mm256_andnot_si256(_mm256_cmpgt_epi16(t, cur),
+                                    _mm256_cmpgt_epi16(t, prev));
+    *count += __builtin_popcount(_mm256_movemask_epi8(m)) / 2;
+  }
+  return i;
+}
+
+#elif defined(COLUMNS_SSE2)
+
+static size_t stats_vec(const int16_t *col, size_t n, struct column_stats *out) {
+  __m128i vmin = _mm_set1_epi16(INT16_MAX);
+  __m128i vmax = _mm_set1_epi16(INT16_MIN);
+  __m128i ones = _mm_set1_epi16(1);
+  size_t i = 0;
+
+  while (i + 8 <= n) {
+    __m128i acc = _mm_setzero_si128();
+    for (size_t v = 0; v < CHUNK_VECTORS && i + 8 <= n; v++, i += 8) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(col + i));
+      vmin = _mm_min_epi16(vmin, x);
+      vmax = _mm_max_epi16(vmax, x);
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(x, ones));
+    }
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    for (int l = 0; l < 4; l++) {
+      out->sum += lanes[l];
+    }
+  }
+
+  int16_t mins[8], maxs[8];
+  _mm_storeu_si128((__m128i *)mins, vmin);
+  _mm_storeu_si128((__m128i *)maxs, vmax);
+  for (int l = 0; l < 8; l++) {
+    if (mins[l] < out->min) out->min = mins[l];
+    if (maxs[l] > out->max) out->max = maxs[l];
+  }
+  out->count += i;
+  return i;
+}
+
+// All-ones lanes where lo <= x <= hi
+static inline __m128i in_range(__m128i x, __m128i lo, __m128i hi) {
+  __m128i out = _mm_or_si128(_mm_cmplt_epi16(x, lo), _mm_cmpgt_epi16(x, hi));
+  return _mm_xor_si128(out, _mm_set1_epi16(-1));
+}
+
+static size_t count_range_vec(const int16_t *col, size_t n,
+                              int16_t lo, int16_t hi, size_t *count) {
+  __m128i vlo = _mm_set1_epi16(lo), vhi = _mm_set1_epi16(hi);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(col + i));
+    *count += __builtin_popcount(_mm_movemask_epi8(in_range(x, vlo, vhi))) / 2;
+  }
+  return i;
+}
+
+static size_t filter_range_vec(const int16_t *col, size_t n, int16_t lo, int16_t hi,
+                               uint8_t *mask, size_t *count) {
+  __m128i vlo = _mm_set1_epi16(lo), vhi = _mm_set1_epi16(hi);
+  __m128i one = _mm_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(col + i));
+    __m128i m = in_range(x, vlo, vhi);
+    *count += __builtin_popcount(_mm_movemask_epi8(m)) / 2;
+    _mm_storel_epi64((__m128i *)(mask + i), _mm_and_si128(_mm_packs_epi16(m, m), one));
+  }
+  return i;
+}
+
+static size_t crossings_vec(const int16_t *col, size_t n, int16_t threshold,
+                            size_t *count) {
+  __m128i t = _mm_set1_epi16(threshold);
+  size_t i = 1;
+  for (; i + 8 <= n; i += 8) {
+    __m128i prev = _mm_loadu_si128((const __m128i *)(col + i - 1));
+    __m128i cur = _mm_loadu_si128((const __m128i *)(col + i));
+    __m128i m = _mm_andnot_si128(_mm_cmplt_epi16(cur, t), _mm_cmplt_epi16(prev, t));
+    *count += __builtin_popcount(_mm_movemask_epi8(m)) / 2;
+  }
+  return i;
+}
+
+#elif defined(COLUMNS_NEON)
+
+static size_t stats_vec(const int16_t *col, size_t n, struct column_stats *out) {
+  int16x8_t vmin = vdupq_n_s16(INT16_MAX);
+  int16x8_t vmax = vdupq_n_s16(INT16_MIN);
+  size_t i = 0;
+
+  while (i + 8 <= n) {
+    int32x4_t acc = vdupq_n_s32(0);
+    for (size_t v = 0; v < CHUNK_VECTORS && i + 8 <= n; v++, i += 8) {
+      int16x8_t x = vld1q_s16(col + i);
+      vmin = vminq_s16(vmin, x);
+      vmax = vmaxq_s16(vmax, x);
+      acc = vpadalq_s16(acc, x);
+    }
+    int32_t lanes[4];
+    vst1q_s32(lanes, acc);
+    for (int l = 0; l < 4; l++) {
+      out->sum += lanes[l];
+    }
+  }
+
+  int16_t mins[8], maxs[8];
+  vst1q_s16(mins, vmin);
+  vst1q_s16(maxs, vmax);
+  for (int l = 0; l < 8; l++) {
+    if (mins[l] < out->min) out->min = mins[l];
+    if (maxs[l] > out->max) out->max = maxs[l];
+  }
+  out->count += i;
+  return i;
+}
+
+// Adds up the 16-bit lane counters
+static size_t sum_lanes(uint16x8_t acc) {
+  uint32_t lanes[4];
+  vst1q_u32(lanes, vpaddlq_u16(acc));
+  return (size_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+static size_t count_range_vec(const int16_t *col, size_t n,
+                              int16_t lo, int16_t hi, size_t *count) {
+  int16x8_t vlo = vdupq_n_s16(lo), vhi = vdupq_n_s16(hi);
+  size_t i = 0;
+  while (i + 8 <= n) {
+    // Matching lanes are all ones, so subtracting them counts up by one
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (size_t v = 0; v < CHUNK_VECTORS && i + 8 <= n; v++, i += 8) {
+      int16x8_t x = vld1q_s16(col + i);
+      acc = vsubq_u16(acc, vandq_u16(vcgeq_s16(x, vlo), vcleq_s16(x, vhi)));
+    }
+    *count += sum_lanes(acc);
+  }
+  return i;
+}
+
+static size_t filter_range_vec(const int16_t *col, size_t n, int16_t lo, int16_t hi,
+                               uint8_t *mask, size_t *count) {
+  int16x8_t vlo = vdupq_n_s16(lo), vhi = vdupq_n_s16(hi);
+  uint8x8_t one = vdup_n_u8(1);
+  size_t i = 0;
+  while (i + 8 <= n) {
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (size_t v = 0; v < CHUNK_VECTORS && i + 8 <= n; v++, i += 8) {
+      int16x8_t x = vld1q_s16(col + i);
+      uint16x8_t m = vandq_u16(vcgeq_s16(x, vlo), vcleq_s16(x, vhi));
+      acc = vsubq_u16(acc, m);
+      vst1_u8(mask + i, vand_u8(vmovn_u16(m), one));
+    }
+    *count += sum_lanes(acc);
+  }
+  return i;
+}
+
+static size_t crossings_vec(const int16_t *col, size_t n, int16_t threshold,
+                            size_t *count) {
+  int16x8_t t = vdupq_n_s16(threshold);
+  size_t i = 1;
+  while (i + 8 <= n) {
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (size_t v = 0; v < CHUNK_VECTORS && i + 8 <= n; v++, i += 8) {
+      int16x8_t prev = vld1q_s16(col + i - 1);
+      int16x8_t cur = vld1q_s16(col + i);
+      acc = vsubq_u16(acc, vandq_u16(vcltq_s16(prev, t), vcgeq_s16(cur, t)));
+    }
+    *count += sum_lanes(acc);
+  }
+  return i;
+}
+
+#else
+
+static size_t stats_vec(const int16_t *col, size_t n, struct column_stats *out) {
+  (void)col; (void)n; (void)out;
+  return 0;
+}
+
+static size_t count_range_vec(const int16_t *col, size_t n,
+                              int16_t lo, int16_t hi, size_t *count) {
+  (void)col; (void)n; (void)lo; (void)hi; (void)count;
+  return 0;
+}
+
+static size_t filter_range_vec(const int16_t *col, size_t n, int16_t lo, int16_t hi,
+                               uint8_t *mask, size_t *count) {
+  (void)col; (void)n; (void)lo; (void)hi; (void)mask; (void)count;
+  return 0;
+}
+
+static size_t crossings_vec(const int16_t *col, size_t n, int16_t threshold,
+                            size_t *count) {
+  (void)col; (void)n; (void)threshold; (void)count;
+  return 1;
+}
+
+#endif
+
+void column_stats(const int16_t *col, size_t n, struct column_stats *out) {
+  out->count = 0;
+  out->min = INT16_MAX;
+  out->max = INT16_MIN;
+  out->sum = 0;
+  size_t done = stats_vec(col, n, out);
+  stats_scalar(col + done, n - done, out);
+}
+
+size_t column_count_range(const int16_t *col, size_t n, int16_t lo, int16_t hi) {
+  size_t count = 0;
+  size_t done = count_range_vec(col, n, lo, hi, &count);
+  return count + count_range_scalar(col + done, n - done, lo, hi);
+}
+
+size_t column_filter_range(const int16_t *col, size_t n,
+                           int16_t lo, int16_t hi, uint8_t *mask) {
+  size_t count = 0;
+  size_t done = filter_range_vec(col, n, lo, hi, mask, &count);
+  return count + filter_range_scalar(col + done, n - done, lo, hi, mask + done);
+}
+
+size_t column_crossings(const int16_t *col, size_t n, int16_t threshold) {
+  if (n < 2) {
+    return 0;
+  }
+  size_t count = 0;
+  size_t done = crossings_vec(col, n, threshold, &count);
+  // Vector part covered crossings ending before col[done]
+  return count + crossings_scalar(col + done - 1, n - done + 1, threshold);
+}
+
+// ln(RH) for every humidity in tenths of a percent, so the dew point loop
+// body is a table lookup and a few multiply/adds; built once, on first use,
+// whichever thread gets there first
+static float ln_rh[1001];
+static pthread_once_t ln_rh_once = PTHREAD_ONCE_INIT;
+
+static void build_ln_rh(void) {
+  ln_rh[0] = logf(0.1f / 1000);
+  for (int h = 1; h <= 1000; h++) {
+    ln_rh[h] = logf(h / 1000.0f);
+  }
+}
+
+void column_dew_point(const int16_t *temp, const int16_t *hum, size_t n,
+                      int16_t *out) {
+  pthread_once(&ln_rh_once, build_ln_rh);
+
+  for (size_t i = 0; i < n; i++) {
+    int h = hum[i] < 0 ? 0 : hum[i] > 1000 ? 1000 : hum[i];
+    float t = temp[i] / 10.0f;
+    float gamma = ln_rh[h] + MAGNUS_B * t / (MAGNUS_C + t);
+    out[i] = (int16_t)lrintf(10 * MAGNUS_C * gamma / (MAGNUS_B - gamma));
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef COLUMNS
+#define COLUMNS
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Columnar (structure of arrays) history with vectorised kernels
+//
+// Temperature and humidity are kept as int16 tenths, as transmitted by the
+// sensor, so one 128-bit vector covers eight readings. Kernels use NEON on
+// ARM, AVX2 or SSE2 on x86, and a scalar loop elsewhere; the choice is made
+// at compile time from the target flags (e.g. -mavx2, -mfpu=neon).
+
+struct columns {
+  size_t n;
+  size_t capacity;
+  int64_t *ts;            // Seconds
+  int16_t *temp;          // Tenths of deg C
+  int16_t *hum;           // Tenths of %
+};
+
+struct column_stats {
+  size_t count;
+  int16_t min;
+  int16_t max;
+  int64_t sum;
+};
+
+int columns_init(struct columns *columns, size_t capacity);
+void columns_free(struct columns *columns);
+int columns_push(struct columns *columns, int64_t ts, int16_t temp, int16_t hum);
+
+// Name of the instruction set the kernels were built for
+const char *columns_isa(void);
+
+// Min, max and sum of col[0..n)
+void column_stats(const int16_t *col, size_t n, struct column_stats *out);
+
+// Number of values with lo <= col[i] <= hi
+size_t column_count_range(const int16_t *col, size_t n, int16_t lo, int16_t hi);
+
+// Sets mask[i] to 1 if lo <= col[i] <= hi, else 0; returns number set
+size_t column_filter_range(const int16_t *col, size_t n,
+                           int16_t lo, int16_t hi, uint8_t *mask);
+
+// Number of upward crossings: col[i - 1] < threshold <= col[i]
+size_t column_crossings(const int16_t *col, size_t n, int16_t threshold);
+
+// Dew point in tenths of deg C for each temperature/humidity pair
+void column_dew_point(const int16_t *temp, const int16_t *hum, size_t n,
+                      int16_t *out);
+
+#endif
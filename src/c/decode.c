@@ -0,0 +1,69 @@
+#include "decode.h"
+
+#include "dht.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Parity is fifth byte of transmitted data
+static int check_parity(const uint8_t *data) {
+  if (!(data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF))) {
+    debug_print(stderr, "%s\n", "Checksum failed\n");
+    return ERROR_PARITY;
+  }
+  return NO_ERROR;
+}
+
+// Process data
+// IN: cycles, containing number of cycles at low/high
+// OUT: data, containing five uint8_t that are the bytes received
+// It is the responsibility of the caller to manage both these arrays
+int DHT_process_data(const int *cycles, uint8_t *data) {
+  // The device transmits a 0 by holding the line low for 50us, then high for 28us
+  // The device transmits a 1 by holding the line low for 50us, then high for 70us
+  // So if the number of cycles at high < cycles at low,
+  // the bit received is 0; otherwise, is 1
+
+  // The DHT22 transmits 5 bytes of data
+  // Shift each bit of data into the data array
+  memset(data, 0, NUM_BYTES);
+  for (int i = 0; i < 40; i++) {
+    data[i/8] <<= 1;
+    data[i/8] |= (cycles[i*2+1] > cycles[i*2]) ? 1 : 0;
+  }
+
+  return check_parity(data);
+}
+
+// Median of the five values at v[0], v[2], ... v[8]
+// Seven compare-exchanges without branches, as the lows are too noisy for
+// branches on them to predict well
+static int median5(const int *v) {
+  int a = v[0], b = v[2], c = v[4], d = v[6], e = v[8], t;
+#define EXCHANGE(x, y) t = x < y ? x : y; y = x < y ? y : x; x = t
+  EXCHANGE(a, b);
+  EXCHANGE(d, e);
+  EXCHANGE(a, d);
+  EXCHANGE(b, e);
+  EXCHANGE(b, c);
+  EXCHANGE(c, d);
+  EXCHANGE(b, c);
+#undef EXCHANGE
+  (void)a;
+  (void)e;
+  return c;
+}
+
+int DHT_process_data_median(const int *cycles, uint8_t *data) {
+  memset(data, 0, NUM_BYTES);
+  for (int i = 0; i < NUM_BITS; i++) {
+    // Window of five lows around bit i, kept inside the frame
+    int first = i < 2 ? 0 : (i > NUM_BITS - 3 ? NUM_BITS - 5 : i - 2);
+    int threshold = median5(cycles + first * 2);
+
+    data[i/8] <<= 1;
+    data[i/8] |= cycles[i*2+1] > threshold ? 1 : 0;
+  }
+
+  return check_parity(data);
+}
@@ -0,0 +1,20 @@
+#ifndef DECODE
+#define DECODE
+
+#include <stdint.h>
+
+// Decoders turning captured cycle counts into the sensor's five bytes
+// IN: cycles, 80 counts of polls at low then high for each of the 40 bits
+// OUT: data, the five bytes received; humidity, temperature, parity
+// Return NO_ERROR, or ERROR_PARITY if the checksum doesn't match
+typedef int (*DHT_decoder)(const int *cycles, uint8_t *data);
+
+// Compares each bit's high with the low just before it
+int DHT_process_data(const int *cycles, uint8_t *data);
+
+// Compares each bit's high with the median of the five nearest lows, so one
+// low cut short, e.g. by the reading thread being preempted, can't flip a
+// bit, while still following changes in polling speed within a frame
+int DHT_process_data_median(const int *cycles, uint8_t *data);
+
+#endif
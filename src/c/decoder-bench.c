@@ -0,0 +1,300 @@
+#include "decode.h"
+#include "dht.h"
+#include "fake-gpio.h"
+#include "trace.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Trace-driven benchmark for the decoders and the capture loop
+//
+// Frames of cycle counts, synthetic or recorded, are decoded by each
+// decoder directly, and captured by DHT_capture with the GPIO replaced by a
+// script that plays the frame back one poll at a time, then decoded. Reports time per
+// frame and how often each variant gets the frame right, fails its parity
+// check, or returns wrong data that passed the parity check.
+//
+// decoder-bench [-n frames] [-f FILE]...
+// FILE is a recording from dht-cli --record, or holds one frame per line: 80
+// low/high cycle counts, optionally followed by the 5 bytes sent, in hex, to
+// also measure accuracy
+
+#define FRAMES 20000
+#define REPEATS 20
+#define MAX_FILES 8
+#define POLLS_PER_US 5.0    // Roughly a Pi 3 polling the line
+#define FAKE_PIN DHT_PIN
+
+struct frame {
+  int cycles[NUM_BITS * 2];
+  uint8_t truth[NUM_BYTES];
+};
+
+struct corpus {
+  const char *name;
+  struct frame *frames;
+  size_t n;
+  int has_truth;
+};
+
+struct result {
+  size_t ok;
+  size_t parity;
+  size_t wrong;
+  size_t failed;
+  uint64_t polls;
+};
+
+static double now_s(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double uniform(double lo, double hi) {
+  return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+static int polls(double us) {
+  long p = lround(us * POLLS_PER_US);
+  return p < 1 ? 1 : p;
+}
+
+// Random humidity and temperature, sign and magnitude as the DHT22 sends them
+static void random_truth(uint8_t *truth) {
+  int hum = rand() % 1001;
+  int temp = rand() % 1201 - 400;
+  uint16_t raw_temp = temp < 0 ? 0x8000 | -temp : temp;
+  truth[0] = hum >> 8;
+  truth[1] = hum & 0xFF;
+  truth[2] = raw_temp >> 8;
+  truth[3] = raw_temp & 0xFF;
+  truth[4] = (truth[0] + truth[1] + truth[2] + truth[3]) & 0xFF;
+}
+
+// Nominal timings: 50 us low, then 26 us high for a 0 or 70 us for a 1
+// Each segment is scaled by a random factor within 1 +/- jitter, and the
+// second half of the frame by second_half, as if the CPU clock changed
+static void synthesise(struct frame *frame, double jitter, double second_half) {
+  random_truth(frame->truth);
+  for (int i = 0; i < NUM_BITS; i++) {
+    int bit = (frame->truth[i/8] >> (7 - i % 8)) & 1;
+    double scale = i < NUM_BITS / 2 ? 1 : second_half;
+    frame->cycles[i*2] = polls(50 * scale * uniform(1 - jitter, 1 + jitter));
+    frame->cycles[i*2+1] = polls((bit ? 70 : 26) * scale *
+                                 uniform(1 - jitter, 1 + jitter));
+  }
+}
+
+static struct corpus synthetic(const char *name, size_t n, double jitter,
+                               double second_half, int preempt) {
+  struct corpus corpus = {name, calloc(n, sizeof(struct frame)), n, 1};
+  for (size_t i = 0; i < n; i++) {
+    synthesise(&corpus.frames[i], jitter, second_half);
+
+    // Polls missed while the reading thread was preempted
+    if (preempt) {
+      int *segment = &corpus.frames[i].cycles[rand() % (NUM_BITS * 2)];
+      *segment = *segment * uniform(0.1, 0.7) + 1;
+    }
+  }
+  return corpus;
+}
+
+// Takes the captured frames of a dht-cli recording; what was sent is unknown
+static int load_trace(const char *path, struct corpus *corpus) {
+  struct trace_map map;
+  if (trace_map(&map, path)) {
+    return -1;
+  }
+  corpus->name = path;
+  corpus->frames = calloc(map.n ? map.n : 1, sizeof(struct frame));
+  corpus->n = 0;
+  corpus->has_truth = 0;
+  for (size_t i = 0; corpus->frames && i < map.n; i++) {
+    const struct trace_record *record = &map.records[i];
+    if (record->stage == DHT_STAGE_OK || record->stage == DHT_STAGE_PARITY ||
+        record->stage == DHT_STAGE_RANGE) {
+      trace_cycles(record, corpus->frames[corpus->n++].cycles);
+    }
+  }
+  trace_unmap(&map);
+  return corpus->frames && corpus->n ? 0 : -1;
+}
+
+static int load_file(const char *path, struct corpus *corpus) {
+  uint32_t magic = 0;
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    perror(path);
+    return -1;
+  }
+  if (fread(&magic, sizeof(magic), 1, file) == 1 && magic == TRACE_MAGIC) {
+    fclose(file);
+    return load_trace(path, corpus);
+  }
+  rewind(file);
+
+  size_t capacity = 1024;
+  corpus->name = path;
+  corpus->frames = malloc(capacity * sizeof(struct frame));
+  corpus->n = 0;
+  corpus->has_truth = 1;
+
+  char line[2048];
+  while (corpus->frames && fgets(line, sizeof(line), file)) {
+    if (corpus->n == capacity) {
+      // On failure the frames read so far stay valid, and are what's run
+      struct frame *frames = realloc(corpus->frames,
+                                     capacity * 2 * sizeof(struct frame));
+      if (!frames) {
+        fprintf(stderr, "%s: out of memory after %zu frames\n", path, corpus->n);
+        break;
+      }
+      corpus->frames = frames;
+      capacity *= 2;
+    }
+    struct frame *frame = &corpus->frames[corpus->n];
+    char *p = line, *end;
+    int i;
+    for (i = 0; i < NUM_BITS * 2; i++, p = end) {
+      frame->cycles[i] = strtol(p, &end, 10);
+      if (end == p) {
+        break;
+      }
+    }
+    if (i < NUM_BITS * 2) {
+      continue;     // Blank, comment or short line
+    }
+    for (i = 0; i < NUM_BYTES; i++, p = end) {
+      frame->truth[i] = strtoul(p, &end, 16);
+      if (end == p) {
+        corpus->has_truth = 0;
+        break;
+      }
+    }
+    corpus->n++;
+  }
+  fclose(file);
+  return corpus->frames && corpus->n ? 0 : -1;
+}
+
+static int decode_compare(const struct frame *frame, uint8_t *data) {
+  return DHT_process_data(frame->cycles, data);
+}
+
+static int decode_median(const struct frame *frame, uint8_t *data) {
+  return DHT_process_data_median(frame->cycles, data);
+}
+
+// Capture over the scripted GPIO, then the default decoder
+static int capture(const struct frame *frame, uint8_t *data) {
+  int cycles[NUM_BITS * 2];
+  int stage;
+  fake_gpio_load(polls(80), polls(80), frame->cycles);
+  int err = DHT_capture(FAKE_PIN, cycles, &stage);
+  return err ? err : DHT_process_data(cycles, data);
+}
+
+struct variant {
+  const char *name;
+  int (*run)(const struct frame *frame, uint8_t *data);
+  int repeats;
+};
+
+static const struct variant variants[] = {
+  {"compare", decode_compare, REPEATS},
+  {"median", decode_median, REPEATS},
+  {"capture", capture, 2},
+};
+
+static void bench(const struct corpus *corpus, const struct variant *variant) {
+  struct result result;
+  memset(&result, 0, sizeof(result));
+  uint8_t data[NUM_BYTES];
+
+  double start = now_s();
+  for (int r = 0; r < variant->repeats; r++) {
+    for (size_t i = 0; i < corpus->n; i++) {
+      int err = variant->run(&corpus->frames[i], data);
+      if (r) {
+        continue;
+      }
+      result.polls += fake_gpio_polls();
+      if (err == ERROR_PARITY) {
+        result.parity++;
+      } else if (err) {
+        result.failed++;
+      } else if (!corpus->has_truth ||
+                 !memcmp(data, corpus->frames[i].truth, NUM_BYTES - 1)) {
+        result.ok++;
+      } else {
+        result.wrong++;
+      }
+    }
+  }
+  double elapsed = now_s() - start;
+
+  double n = corpus->n;
+  printf("%-14s %-8s %10.1f %8.2f %8.2f %8.2f %8.2f",
+         corpus->name, variant->name,
+         elapsed * 1e9 / (n * variant->repeats),
+         100 * result.ok / n, 100 * result.parity / n,
+         100 * result.wrong / n, 100 * result.failed / n);
+  if (variant->run == capture) {
+    printf("  %.1f ns/poll", elapsed * 1e9 / (result.polls * variant->repeats));
+  }
+  printf("%s\n", corpus->has_truth || variant->run == capture ? "" : "  (ok = parity passed)");
+}
+
+int main(int argc, char **argv) {
+  size_t frames = FRAMES;
+  const char *files[MAX_FILES];
+  int nfiles = 0;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:f:")) != -1) {
+    switch (c) {
+      case 'n':
+        frames = strtoul(optarg, NULL, 10);
+        break;
+      case 'f':
+        if (nfiles < MAX_FILES) {
+          files[nfiles++] = optarg;
+        }
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n frames] [-f FILE]...\n", argv[0]);
+        return 1;
+    }
+  }
+
+  srand(1);
+  struct corpus corpora[4 + MAX_FILES];
+  int ncorpora = 0;
+  corpora[ncorpora++] = synthetic("clean", frames, 0.05, 1, 0);
+  corpora[ncorpora++] = synthetic("jitter", frames, 0.25, 1, 0);
+  corpora[ncorpora++] = synthetic("preempted", frames, 0.05, 1, 1);
+  corpora[ncorpora++] = synthetic("clock-step", frames, 0.05, 0.5, 0);
+  for (int i = 0; i < nfiles; i++) {
+    if (load_file(files[i], &corpora[ncorpora])) {
+      fprintf(stderr, "%s: no frames\n", files[i]);
+      return 1;
+    }
+    ncorpora++;
+  }
+
+  printf("%-14s %-8s %10s %8s %8s %8s %8s\n", "corpus", "variant",
+         "ns/frame", "ok%", "parity%", "wrong%", "failed%");
+  for (int i = 0; i < ncorpora; i++) {
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+      bench(&corpora[i], &variants[v]);
+    }
+    free(corpora[i].frames);
+  }
+  return 0;
+}
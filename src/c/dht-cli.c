@@ -1,34 +1,207 @@
-#include "dht.h"
-
-#include "stdio.h"
-#include "stdlib.h"
-#include "unistd.h"
-
-int main(int argc, char **argv) {
-  int pin = DHT_PIN;
-  int retries = RETRIES;
-
-  // Get argument for pin
-  int c;
-  while ((c = getopt(argc, argv, "p:r:")) != -1) {
-    switch (c) {
-      case 'p':
-        pin = atoi(optarg);
-        break;
-      case 'r':
-        retries = atoi(optarg);
-        break;
-    }
-  }
-
-  double humidity, temperature;
-
-  DHT_init(pin);
-  int err = DHT_read_data(pin, retries, &humidity, &temperature);
-  if (err) {
-    printf("Couldn't read temperature!\n");
-  }
-  printf("Relative humidity: %f\n", humidity);
-  printf("Temperature: %f\n", temperature);
-  DHT_deinit();
+#include "cli.h"
+#include "dht.h"
+#include "latency.h"
+#include "model.h"
+#include "trace.h"
+#include "vcd.h"
+
+#include "getopt.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+// Prints the diagnostics of a read
+static void print_diagnostics(const struct DHT_diagnostics *diag) {
+  printf("Attempts: %d (", diag->attempts);
+  int shown = diag->attempts < DHT_MAX_ATTEMPTS ? diag->attempts : DHT_MAX_ATTEMPTS;
+  for (int i = 0; i < shown; i++) {
+    printf("%s%s", i ? ", " : "", DHT_stage_str(diag->stages[i]));
+  }
+  printf(")\n");
+  printf("Wall time: %.3f ms, real-time priority: %s, %.3f ms\n",
+         diag->wall_ns / 1e6, diag->realtime_priority ? "yes" : "no",
+         diag->rt_ns / 1e6);
+  printf("Response cycles: low %u, high %u\n",
+         diag->ack_low_cycles, diag->ack_high_cycles);
+  printf("Bits: %.1f us, min margin %d cycles at bit %d\n",
+         diag->bits_ns / 1e3, diag->min_margin, diag->min_margin_bit);
+  for (int i = 0; i < NUM_BITS; i++) {
+    printf("%2d: Low: %u; high: %u\n",
+           i, diag->low_cycles[i], diag->high_cycles[i]);
+  }
+}
+
+// Reads the sensor count times, as often as it allows, then prints how long
+// each phase of the reads took
+static int benchmark(int pin, int retries, int count,
+                     const struct DHT_model_info *model) {
+  static struct latency_set latency;
+  DHT_set_latency(pin, &latency);
+
+  int failed = 0;
+  for (int i = 0; i < count; i++) {
+    if (i) {
+      struct timespec interval = {model->min_interval_ms / 1000,
+                                  model->min_interval_ms % 1000 * 1000000L};
+      nanosleep(&interval, NULL);
+    }
+
+    double humidity, temperature;
+    if (DHT_init(pin) ||
+        DHT_read_data(pin, retries, &humidity, &temperature)) {
+      failed++;
+    }
+    DHT_deinit();
+    fprintf(stderr, "\r%d/%d reads, %d failed", i + 1, count, failed);
+  }
+  fprintf(stderr, "\n");
+
+  char table[1024];
+  latency_format(&latency, table, sizeof(table));
+  printf("Latency in us over %d reads:\n%s", count, table);
+  DHT_set_latency(pin, NULL);
+  return failed == count;
+}
+
+// Where the attempts of the reads below go: appended to a trace file, and
+// kept for a VCD dump
+struct capture {
+  struct trace *trace;
+  int keep;
+  int n;
+  struct trace_record records[DHT_MAX_ATTEMPTS];
+};
+
+static void capture_attempt(void *ctx, const struct DHT_attempt *attempt) {
+  struct capture *capture = ctx;
+  if (capture->trace) {
+    trace_append(capture->trace, attempt);
+  }
+  if (capture->keep && capture->n < DHT_MAX_ATTEMPTS) {
+    trace_fill(&capture->records[capture->n], attempt);
+    trace_stamp_cpu(&capture->records[capture->n++]);
+  }
+}
+
+static const struct option options[] = {
+  {"record", required_argument, NULL, 'R'},
+  {"replay", required_argument, NULL, 'P'},
+  {"vcd", required_argument, NULL, 'V'},
+  {NULL, 0, NULL, 0},
+};
+
+int main(int argc, char **argv) {
+  // Offline analysis subcommands
+  if (argc > 1 && !strcmp(argv[1], "history")) {
+    return cli_history(argc - 1, argv + 1);
+  }
+  if (argc > 1 && !strcmp(argv[1], "analyze")) {
+    return cli_analyze(argc - 1, argv + 1);
+  }
+  if (argc > 1 && !strcmp(argv[1], "vcd")) {
+    return cli_vcd(argc - 1, argv + 1);
+  }
+
+  int pin = DHT_PIN;
+  int retries = RETRIES;
+  int diagnose = 0;
+  int reads = 0;
+  const char *record = NULL;
+  const char *vcd = NULL;
+  int model = DHT_MODEL_DHT22;
+
+  // Get argument for pin
+  int c;
+  while ((c = getopt_long(argc, argv, "p:r:db:m:", options, NULL)) != -1) {
+    switch (c) {
+      case 'p':
+        pin = atoi(optarg);
+        break;
+      case 'r':
+        retries = atoi(optarg);
+        break;
+      case 'd':
+        diagnose = 1;
+        break;
+      case 'b':
+        reads = atoi(optarg);
+        break;
+      case 'm':
+        model = DHT_model_parse(optarg);
+        if (model < 0) {
+          fprintf(stderr, "%s: unknown model\n", optarg);
+          return 1;
+        }
+        break;
+      case 'R':
+        record = optarg;
+        break;
+      case 'P':
+        return cli_replay(optarg);
+      case 'V':
+        vcd = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-p pin] [-r retries] [-m model] [-d] [-b reads] "
+                        "[--record FILE] [--replay FILE] [--vcd FILE]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  // Keep the raw timings of every attempt made below
+  struct trace trace;
+  static struct capture capture;
+  if (record) {
+    if (trace_open(&trace, record)) {
+      fprintf(stderr, "%s: couldn't open trace for recording\n", record);
+      return 1;
+    }
+    capture.trace = &trace;
+  }
+  capture.keep = vcd != NULL;
+  if (record || vcd) {
+    DHT_set_attempt_hook(capture_attempt, &capture);
+  }
+
+  if (DHT_set_model(pin, model)) {
+    fprintf(stderr, "%d: invalid pin\n", pin);
+    return 1;
+  }
+
+  if (reads > 0) {
+    int err = benchmark(pin, retries, reads, DHT_model_info(model));
+    if (record) {
+      trace_close(&trace);
+    }
+    if (vcd && vcd_write(vcd, capture.records, capture.n)) {
+      fprintf(stderr, "%s: couldn't write VCD\n", vcd);
+    }
+    return err;
+  }
+
+  double humidity, temperature;
+  struct DHT_diagnostics diag;
+
+  DHT_init(pin);
+  int err = DHT_read_data_diag(pin, retries, &humidity, &temperature,
+                               diagnose ? &diag : NULL);
+  if (err) {
+    printf("Couldn't read temperature!\n");
+  }
+  if (diagnose) {
+    print_diagnostics(&diag);
+  }
+  printf("Relative humidity: %f\n", humidity);
+  printf("Temperature: %f\n", temperature);
+  DHT_deinit();
+  if (record) {
+    printf("Recorded %llu attempts to %s\n",
+           (unsigned long long)trace.records, record);
+    trace_close(&trace);
+  }
+  if (vcd && vcd_write(vcd, capture.records, capture.n)) {
+    fprintf(stderr, "%s: couldn't write VCD\n", vcd);
+  }
 }
\ No newline at end of file
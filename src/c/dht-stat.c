@@ -0,0 +1,107 @@
+#include "dht.h"
+#include "stats.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+// dht-stat [-f FILE] [-p PIN] [interval [count]]
+// Shows the shared read counters like vmstat: the first report covers
+// everything counted so far, each later one the last interval
+
+#define HEADER_EVERY 20
+
+static void print_header(void) {
+  printf("%3s %7s %7s %7s %6s %6s %6s %6s %6s %9s %6s %8s\n",
+         "pin", "reads", "ok", "retries", "to-lo", "to-hi", "to-bit",
+         "parity", "range", "busy-ms", "cpu%", "last-ok");
+}
+
+static void print_row(int pin, const struct stats_pin *now,
+                      const struct stats_pin *then, double seconds) {
+  char age[16] = "-";
+  if (now->last_success_ns) {
+    snprintf(age, sizeof(age), "%.0fs",
+             (stats_now_ns() - now->last_success_ns) / 1e9);
+  }
+  double busy_ms = (now->busy_ns - then->busy_ns) / 1e6;
+
+  printf("%3d %7llu %7llu %7llu %6llu %6llu %6llu %6llu %6llu %9.1f %6.2f %8s\n",
+         pin,
+         (unsigned long long)(now->reads - then->reads),
+         (unsigned long long)(now->successes - then->successes),
+         (unsigned long long)(now->retries - then->retries),
+         (unsigned long long)(now->response_low_timeouts - then->response_low_timeouts),
+         (unsigned long long)(now->response_high_timeouts - then->response_high_timeouts),
+         (unsigned long long)(now->bit_timeouts - then->bit_timeouts),
+         (unsigned long long)(now->parity_failures - then->parity_failures),
+         (unsigned long long)(now->range_failures - then->range_failures),
+         busy_ms, seconds > 0 ? busy_ms / (seconds * 10) : 0, age);
+}
+
+int main(int argc, char **argv) {
+  const char *path = STATS_PATH;
+  int only_pin = -1;
+
+  int c;
+  while ((c = getopt(argc, argv, "f:p:")) != -1) {
+    switch (c) {
+      case 'f':
+        path = optarg;
+        break;
+      case 'p':
+        only_pin = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-f FILE] [-p PIN] [interval [count]]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+  int interval = optind < argc ? atoi(argv[optind]) : 0;
+  int count = optind + 1 < argc ? atoi(argv[optind + 1]) : (interval ? -1 : 1);
+  if (only_pin >= NUM_PINS) {
+    fprintf(stderr, "Invalid pin %d\n", only_pin);
+    return 1;
+  }
+
+  struct stats_file *stats = stats_open(path, 0);
+  if (!stats) {
+    fprintf(stderr, "Couldn't map stats file %s\n", path);
+    return 1;
+  }
+
+  static struct stats_pin last[NUM_PINS];
+  uint64_t last_ns = 0;
+  int rows = 0;
+
+  for (int report = 0; count < 0 || report < count; report++) {
+    if (report) {
+      sleep(interval);
+    }
+    uint64_t now_ns = stats_now_ns();
+    double seconds = last_ns ? (now_ns - last_ns) / 1e9 : 0;
+
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+      struct stats_pin now;
+      stats_snapshot(stats, pin, &now);
+      if ((only_pin >= 0 && pin != only_pin) ||
+          (only_pin < 0 && !now.reads)) {
+        continue;
+      }
+      if (rows % HEADER_EVERY == 0) {
+        print_header();
+      }
+      print_row(pin, &now, &last[pin], seconds);
+      last[pin] = now;
+      rows++;
+    }
+    last_ns = now_ns;
+    fflush(stdout);
+  }
+
+  stats_close(stats);
+  return 0;
+}
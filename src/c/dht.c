@@ -1,211 +1,653 @@
-#include "dht.h"
-
-#include "bcm2835.h"
-
-#include <sched.h>
-#include <sys/mman.h>
-
-#include <stdio.h>
-#include <string.h>
-#include <time.h>
-
-// Poll pin for timeout_cycles until it changes to level or times out
-// Returns 0 after pin changes to and then away from level,
-// ERROR_TIME if timeout_cycles has passed without the level changing
-static int level_or_error(const uint8_t pin, const uint16_t level,
-                          const uint32_t timeout_cycles) {
-  for (unsigned int i = 0; i < timeout_cycles; i++) {
-    if (bcm2835_gpio_lev(pin) == level) {
-      while (bcm2835_gpio_lev(pin) == level) { }
-      return 0;
-    }
-  }
-  return ERROR_TIME;
-}
-
-// Counts number of cycles that pin is at level
-// Returns number of cycles
-static int level_cycles(const uint8_t pin, const uint16_t level) {
-  int count = 0;
-  while (bcm2835_gpio_lev(pin) == level && count < TIMEOUT_CYCLES) {
-    ++count;
-  }
-  return count;
-}
-
-// Communicate with DHT22 to get data
-// OUT: cycles, containing number of cycles at low and high
-// Responsibility of caller to allocate/free 80-int array
-static int DHT_get_data(int pin, int *cycles) {
-  // To start communicating, set GPIO low, then set GPIO high
-  // Hold high for WAIT_TIME, then relinquish control to device
-  bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_OUTP);
-  bcm2835_gpio_clr(pin);
-  bcm2835_delayMicroseconds(HOST_STARTSIG_LOW_TIME_US);
-  bcm2835_gpio_set(pin);
-  bcm2835_delayMicroseconds(HOST_STARTSIG_WAIT_TIME_US);
-  bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
-
-  // Sensor should respond with low then high to acknowledge
-  // start of communication
-  if (level_or_error(pin, LOW, SENSOR_WAIT_TIME_CYCLES)) {
-    debug_print(stderr, "%s\n", "Timed out waiting for sensor response low\n");
-    return ERROR_TIME;
-  }
-  if (level_or_error(pin, HIGH, SENSOR_WAIT_TIME_CYCLES)) {
-    debug_print(stderr, "%s\n", "Timed out waiting for sensor response high\n");
-    return ERROR_TIME;
-  }
-
-  // Now, start reading data
-  // There are 40 bits of data
-  // The DHT22 transmits a bit by setting GPIO low for some time, then set high
-  // (See DHT_process_data for more details)
-  // So get the # of cycles that it's set low, then # of cycles set high
-  for (int i = 0; i < 80; i += 2) {
-    cycles[i] = level_cycles(pin, LOW);
-    cycles[i+1] = level_cycles(pin, HIGH);
-  }
-
-  // Return an error if any of the cycles timed out
-  for (int i = 0; i < 80; i += 2) {
-    debug_print(stdout, "%d: Low: %d; high: %d\n", i / 2, cycles[i], cycles[i+1]);
-    if (cycles[i] == TIMEOUT_CYCLES || cycles[i+1] == TIMEOUT_CYCLES) {
-      return ERROR_TIME;
-    }
-  }
-
-  return NO_ERROR;
-}
-
-// Process data
-// IN: cycles, containing number of cycles at low/high
-// OUT: data, containing five uint8_t that are the bytes received
-// It is the responsibility of the caller to manage both these arrays
-static int DHT_process_data(const int *cycles, uint8_t *data) {
-  // The device transmits a 0 by holding the line low for 50us, then high for 28us
-  // The device transmits a 1 by holding the line low for 50us, then high for 70us
-  // So if the number of cycles at high < cycles at low,
-  // the bit received is 0; otherwise, is 1
-
-  // The DHT22 transmits 5 bytes of data
-  // Shift each bit of data into the data array
-  for (int i = 0; i < 40; i++) {
-    data[i/8] <<= 1;
-    data[i/8] |= (cycles[i*2+1] > cycles[i*2]) ? 1 : 0;
-  }
-
-  // Check the parity; parity is fifth byte of transmitted data
-  if (!(data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF))) {
-    debug_print(stderr, "%s\n", "Checksum failed\n");
-    return ERROR_PARITY;
-  }
-
-  return NO_ERROR;
-}
-
-// Convert data
-// IN: data, containing five uint8_t that are the bytes received
-// OUT: doubles for temperature and humidity
-// It is the caller's responsibility to manage all memory
-static int DHT_convert_data(const uint8_t *data,
-                            double *hum_out, double *temp_out) {
-  // First byte of transmitted data is MSB of humidity
-  // Second byte is LSB of humidity
-  // Conversion is humidity / 10
-  uint16_t rel_hum = (data[0] & 0xFF) << 8;
-  rel_hum |= data[1];
-  *hum_out = rel_hum / 10.0;
-
-  // Third byte of transmitted data is MSB of temperature
-  // Fourth byte is LSB of temperature
-  // Conversion is temp / 10
-  uint16_t temp = (data[2] & 0xFF) << 8;
-  temp |= data[3];
-  *temp_out = temp / 10.0;
-
-  debug_print(stdout, "Relative humidity: %f\n", *hum_out);
-  debug_print(stdout, "Temperature: %f\n", *temp_out);
-
-  return NO_ERROR;
-}
-
-// Sets up the BCM2835 driver and GPIO pin
-int DHT_init(const int pin) {
-  if (!bcm2835_init()) {
-    debug_print(stderr, "%s\n", "Couldn't init bcm2835!\n");
-    return ERROR_DRIVER;
-  }
-
-  // Set up the pin as having a pull-up resistor
-  bcm2835_gpio_set_pud(pin, BCM2835_GPIO_PUD_UP);
-
-  return 0;
-}
-
-// Frees memory allocated by bcm2835_init()
-int DHT_deinit() {
-  bcm2835_close();
-  return 0;
-}
-
-// Gets data from device
-int DHT_read_data(const int pin, const int max_retries,
-                  double *humidity, double *temperature) {
-  // Check for valid arguments
-  if (!humidity || !temperature) {
-    return ERROR_INVAL;
-  }
-
-  // Prevent swapping
-  struct sched_param sp;
-  memset(&sp, 0, sizeof(sp));
-  sp.sched_priority = sched_get_priority_max(SCHED_FIFO);
-  sched_setscheduler(0, SCHED_FIFO, &sp);
-  mlockall(MCL_CURRENT | MCL_FUTURE);
-
-  int retries = 0;
-  int err = NO_ERROR;
-  int cycles[NUM_BITS * 2];
-  uint8_t data[NUM_BYTES];
-
-  // Try to contact device until we've exceeded max_retries
-  do {
-    // Reset err and cycles, and fetch info from device
-    err = NO_ERROR;
-    memset(cycles, 0, sizeof(cycles));
-    err |= DHT_get_data(pin, cycles);
-
-    if (err) {
-      struct timespec sleep_time = {0, SENSOR_COOLDOWN_TIME_NS};
-      nanosleep(&sleep_time, NULL);
-      retries++;
-      continue;
-    }
-
-    debug_print(stdout, "%s\n", "Got data from device!\n");
-
-    // Reset array of data, and process data
-    memset(data, 0, sizeof(data));
-    err |= DHT_process_data(cycles, data);
-
-    if (err) {
-      struct timespec sleep_time = {0, SENSOR_COOLDOWN_TIME_NS};
-      nanosleep(&sleep_time, NULL);
-      retries++;
-      continue;
-    }
-
-    debug_print(stdout, "%s\n", "Processed data from device!\n");
-  }  while (retries < max_retries && err);
-
-  // Max retries exceeded and there is still an error, so return it
-  if (err) {
-    return err;
-  }
-
-  // Convert the data and put it in the out structure
-  DHT_convert_data(data, humidity, temperature);
-
-  return NO_ERROR;
-}
+#include "dht.h"
+
+#include "bcm2835.h"
+#include "capture_engine.h"
+#include "decode.h"
+#include "filter.h"
+#include "gpio_fast.h"
+#include "latency.h"
+#include "model.h"
+#include "probes.h"
+#include "stats.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Semaphores of the USDT probes, set while a tracer is attached
+DHT_PROBE_SEMAPHORES
+
+// t moved back by ns
+static struct timespec minus_ns(const struct timespec *t, int64_t ns) {
+  int64_t total = (int64_t)t->tv_sec * 1000000000 + t->tv_nsec - ns;
+  struct timespec result = {total / 1000000000, total % 1000000000};
+  return result;
+}
+
+static int64_t elapsed_ns(const struct timespec *from, const struct timespec *to) {
+  return (int64_t)(to->tv_sec - from->tv_sec) * 1000000000 +
+         (to->tv_nsec - from->tv_nsec);
+}
+
+// Mapping of the registers shared by every thread, opened by the first
+// DHT_open and closed by the last DHT_close; it is only used through the
+// reentrant bcm2835_ctx functions, so nothing else calling bcm2835_init or
+// bcm2835_close in the process can remap it. driver_lock also serialises
+// pull-up changes, which go through registers shared by every pin
+static struct bcm2835_ctx driver;
+static int driver_users;
+static pthread_mutex_t driver_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Each function select register holds the mode of ten pins, and is changed
+// by read-modify-write, so changes on different threads mustn't interleave
+static pthread_mutex_t fsel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_mode(const struct bcm2835_ctx *ctx,
+                     const uint8_t pin, const uint8_t mode) {
+  pthread_mutex_lock(&fsel_lock);
+  bcm2835_ctx_gpio_fsel(ctx, pin, mode);
+  pthread_mutex_unlock(&fsel_lock);
+}
+
+static void set_pull_up(const struct bcm2835_ctx *ctx, const uint8_t pin) {
+  pthread_mutex_lock(&driver_lock);
+  bcm2835_ctx_gpio_set_pud(ctx, pin, BCM2835_GPIO_PUD_UP);
+  pthread_mutex_unlock(&driver_lock);
+}
+
+// Latency histograms registered for each pin with DHT_set_latency
+static struct latency_set *latency_sets[NUM_PINS];
+
+static struct latency_set *latency_for(const int pin) {
+  return pin >= 0 && pin < NUM_PINS ? latency_sets[pin] : NULL;
+}
+
+// Sensor model on each pin, set with DHT_set_model; DHT22 unless set
+static int pin_models[NUM_PINS];
+
+static const struct DHT_model_info *model_for(const int pin) {
+  return DHT_model_info(pin >= 0 && pin < NUM_PINS ? pin_models[pin]
+                                                   : DHT_MODEL_DHT22);
+}
+
+// A hook with its ctx, published together by DHT_set_attempt_hook
+struct hook_binding {
+  DHT_attempt_hook hook;
+  void *ctx;
+};
+
+// Every pair ever set, never freed or changed, so a read that loaded one
+// just before the hook changed still calls a whole, valid pair
+static struct hook_binding hook_bindings[MAX_ATTEMPT_HOOKS];
+static int nhook_bindings;
+static pthread_mutex_t hook_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Called after every attempt, or NULL; loaded once per attempt
+static const struct hook_binding *current_hook;
+
+// Shared counters set with DHT_set_stats
+static struct stats_file *stats_file;
+
+static struct stats_file *stats_for(const int pin) {
+  return pin >= 0 && pin < NUM_PINS ? stats_file : NULL;
+}
+
+static void record_phase(struct latency_set *latency, const int phase,
+                         const struct timespec *from, const struct timespec *to) {
+  if (latency) {
+    latency_record(&latency->phases[phase], elapsed_ns(from, to));
+  }
+}
+
+// Communicate with DHT22 to get data
+// OUT: cycles, containing number of cycles at low and high
+// OUT: stage, the enum DHT_stage at which communication failed
+// OUT: timing, gets the response cycles and time taken by the bits
+// OUT: diag, if not NULL, gets the response and bit timings
+// Responsibility of caller to allocate/free 80-int array
+static int DHT_get_data(const struct bcm2835_ctx *ctx,
+                        int pin, int *cycles, struct DHT_attempt *timing,
+                        int *stage,
+                        struct DHT_diagnostics *diag) {
+  struct latency_set *latency = latency_for(pin);
+  // The sampling loops, compiled for this pin (see capture_engine.hpp)
+  const struct DHT_pollers *poll = DHT_pollers_for(pin);
+  struct timespec signal, released, acked, low_end, start, end;
+  int ack_low = 0, ack_high = 0;
+  timing->ack_low_cycles = timing->ack_high_cycles = 0;
+  timing->bits_ns = 0;
+
+  // To start communicating, set GPIO low, then set GPIO high
+  // Hold high for WAIT_TIME, then relinquish control to device
+  DHT_PROBE1(start_signal, pin);
+  clock_gettime(CLOCK_MONOTONIC, &signal);
+  low_end = signal;
+  set_mode(ctx, pin, BCM2835_GPIO_FSEL_OUTP);
+  bcm2835_ctx_gpio_clr(ctx, pin);
+  bcm2835_ctx_delayMicroseconds(ctx, model_for(pin)->start_low_us);
+  bcm2835_ctx_gpio_set(ctx, pin);
+  bcm2835_ctx_delayMicroseconds(ctx, HOST_STARTSIG_WAIT_TIME_US);
+  set_mode(ctx, pin, BCM2835_GPIO_FSEL_INPT);
+  gpio_line_begin();
+  clock_gettime(CLOCK_MONOTONIC, &released);
+  record_phase(latency, LATENCY_START, &signal, &released);
+
+  // Sensor should respond with low then high to acknowledge
+  // start of communication
+  if (poll->level_or_error(ctx, LOW, SENSOR_WAIT_TIME_CYCLES, &ack_low)) {
+    gpio_line_end();
+    debug_print(stderr, "%s\n", "Timed out waiting for sensor response low\n");
+    *stage = DHT_STAGE_RESPONSE_LOW;
+    clock_gettime(CLOCK_MONOTONIC, &acked);
+    record_phase(latency, LATENCY_RESPONSE, &released, &acked);
+    return ERROR_TIME;
+  }
+  // Timed only while traced; ack_low reports it once the capture is over
+  if (DHT_PROBE_ENABLED(ack_low)) {
+    clock_gettime(CLOCK_MONOTONIC, &low_end);
+  }
+  timing->ack_low_cycles = ack_low;
+  if (poll->level_or_error(ctx, HIGH, SENSOR_WAIT_TIME_CYCLES, &ack_high)) {
+    gpio_line_end();
+    DHT_PROBE3(ack_low, pin, ack_low, elapsed_ns(&signal, &low_end));
+    debug_print(stderr, "%s\n", "Timed out waiting for sensor response high\n");
+    *stage = DHT_STAGE_RESPONSE_HIGH;
+    clock_gettime(CLOCK_MONOTONIC, &acked);
+    record_phase(latency, LATENCY_RESPONSE, &released, &acked);
+    return ERROR_TIME;
+  }
+
+  timing->ack_high_cycles = ack_high;
+
+  // Now, start reading data
+  // There are 40 bits of data
+  // The DHT22 transmits a bit by setting GPIO low for some time, then set high
+  // (See DHT_process_data for more details)
+  // So get the # of cycles that it's set low, then # of cycles set high
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < 80; i += 2) {
+    cycles[i] = poll->level_cycles(ctx, LOW, TIMEOUT_CYCLES);
+    cycles[i+1] = poll->level_cycles(ctx, HIGH, TIMEOUT_CYCLES);
+  }
+  gpio_line_end();
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  // Recorded only now so bookkeeping doesn't delay the first bit
+  record_phase(latency, LATENCY_RESPONSE, &released, &start);
+  record_phase(latency, LATENCY_BITS, &start, &end);
+  timing->bits_ns = elapsed_ns(&start, &end);
+  DHT_PROBE3(ack_low, pin, ack_low, elapsed_ns(&signal, &low_end));
+  DHT_PROBE2(ack_high, pin, ack_high);
+  if (DHT_PROBE_ENABLED(bit)) {
+    for (int i = 0; i < NUM_BITS; i++) {
+      DHT_PROBE4(bit, pin, i, cycles[i*2], cycles[i*2+1]);
+    }
+  }
+
+  if (diag) {
+    diag->ack_low_cycles = ack_low;
+    diag->ack_high_cycles = ack_high;
+    diag->bits_ns = timing->bits_ns;
+    diag->monotonic = start;
+    clock_gettime(CLOCK_REALTIME, &diag->realtime);
+    diag->min_margin = TIMEOUT_CYCLES;
+    diag->min_margin_bit = 0;
+    for (int i = 0; i < NUM_BITS; i++) {
+      diag->low_cycles[i] = cycles[i*2];
+      diag->high_cycles[i] = cycles[i*2+1];
+      int margin = abs(cycles[i*2+1] - cycles[i*2]);
+      if (margin < diag->min_margin) {
+        diag->min_margin = margin;
+        diag->min_margin_bit = i;
+      }
+    }
+  }
+
+  // Return an error if any of the cycles timed out
+  for (int i = 0; i < 80; i += 2) {
+    debug_print(stdout, "%d: Low: %d; high: %d\n", i / 2, cycles[i], cycles[i+1]);
+    if (cycles[i] == TIMEOUT_CYCLES || cycles[i+1] == TIMEOUT_CYCLES) {
+      *stage = DHT_STAGE_BITS;
+      return ERROR_TIME;
+    }
+  }
+
+  *stage = DHT_STAGE_OK;
+  return NO_ERROR;
+}
+
+int DHT_capture(const int pin, int *cycles, int *stage) {
+  if (!cycles || !stage || pin < 0 || pin >= NUM_PINS) {
+    return ERROR_INVAL;
+  }
+  struct DHT_attempt timing;
+  return DHT_get_data(&driver, pin, cycles, &timing, stage, NULL);
+}
+
+// Maps the BCM2835 driver's registers for the first user
+// The first successful open also locks the process's memory, so pages
+// don't fault in or swap while reading; that lasts for the process
+int DHT_open(void) {
+  static int memory_locked;
+  int err = NO_ERROR;
+  pthread_mutex_lock(&driver_lock);
+  if (driver_users == 0 && !bcm2835_ctx_open(&driver, 0)) {
+    debug_print(stderr, "%s\n", "Couldn't init bcm2835!\n");
+    err = ERROR_DRIVER;
+  } else {
+    driver_users++;
+    if (!memory_locked) {
+      mlockall(MCL_CURRENT | MCL_FUTURE);
+      memory_locked = 1;
+    }
+  }
+  pthread_mutex_unlock(&driver_lock);
+  return err;
+}
+
+// Unmaps the registers once the last user is gone
+int DHT_close(void) {
+  pthread_mutex_lock(&driver_lock);
+  if (driver_users > 0 && --driver_users == 0) {
+    bcm2835_ctx_close(&driver);
+  }
+  pthread_mutex_unlock(&driver_lock);
+  return 0;
+}
+
+// Sets up the BCM2835 driver and GPIO pin
+int DHT_init(const int pin) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (DHT_open()) {
+    return ERROR_DRIVER;
+  }
+
+  // Set up the pin as having a pull-up resistor
+  set_pull_up(&driver, pin);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  record_phase(latency_for(pin), LATENCY_INIT, &start, &end);
+  return 0;
+}
+
+int DHT_deinit() {
+  return DHT_close();
+}
+
+// Gets data from device
+int DHT_read_data(const int pin, const int max_retries,
+                  double *humidity, double *temperature) {
+  return DHT_read_data_diag(pin, max_retries, humidity, temperature, NULL);
+}
+
+// Scheduling of the calling thread before enter_realtime
+struct realtime {
+  int policy;
+  struct sched_param param;
+  int raised;             // Whether SCHED_FIFO could be set
+};
+
+// Raises the priority of the calling thread for a read; leave_realtime
+// must follow, as the thread may be one of a pool, e.g. libuv's, that goes
+// on to run unrelated work
+static void enter_realtime(struct realtime *saved) {
+  saved->raised = 0;
+  if (pthread_getschedparam(pthread_self(), &saved->policy, &saved->param)) {
+    return;
+  }
+  struct sched_param sp;
+  memset(&sp, 0, sizeof(sp));
+  sp.sched_priority = sched_get_priority_max(SCHED_FIFO);
+  saved->raised = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) == 0;
+}
+
+// Restores the scheduling saved by enter_realtime
+static void leave_realtime(const struct realtime *saved) {
+  if (saved->raised) {
+    pthread_setschedparam(pthread_self(), saved->policy, &saved->param);
+  }
+}
+
+// Reads pin until it succeeds or max_retries attempts have been made, once
+// the driver is set up and the priority raised
+// start is when the read began, realtime whether SCHED_FIFO was set since
+// OUT: attempts, the number of attempts made
+static int read_pin(const int pin, const int max_retries,
+                    int16_t *humidity, int16_t *temperature, int *attempts,
+                    struct DHT_diagnostics *diag,
+                    const struct timespec *start, const int realtime) {
+  struct latency_set *latency = latency_for(pin);
+  struct stats_file *stats = stats_for(pin);
+  const struct DHT_model_info *model = model_for(pin);
+  struct timespec rt_start, attempt_start, attempt_end,
+                  decode_start, decode_end, end;
+  clock_gettime(CLOCK_MONOTONIC, &rt_start);
+  if (stats) {
+    stats_count_read(stats, pin);
+  }
+  if (diag) {
+    memset(diag, 0, sizeof(*diag));
+  }
+
+  int retries = 0;
+  int err = NO_ERROR;
+  int stage = DHT_STAGE_OK;
+  struct DHT_attempt attempt;
+  int cycles[NUM_BITS * 2];
+  uint8_t data[NUM_BYTES];
+  int16_t hum = 0, temp = 0;
+  int64_t hook_ns = 0;    // Spent in the attempt hook, left out of timings
+
+  // Try to contact device until we've exceeded max_retries
+  do {
+    // Reset err and cycles, and fetch info from device
+    err = NO_ERROR;
+    memset(cycles, 0, sizeof(cycles));
+    clock_gettime(CLOCK_MONOTONIC, &attempt_start);
+    err |= DHT_get_data(&driver, pin, cycles, &attempt, &stage, diag);
+    clock_gettime(CLOCK_MONOTONIC, &attempt_end);
+
+    if (!err) {
+      debug_print(stdout, "%s\n", "Got data from device!\n");
+
+      // Reset array of data, and process data
+      clock_gettime(CLOCK_MONOTONIC, &decode_start);
+      memset(data, 0, sizeof(data));
+      err |= DHT_process_data(cycles, data);
+      // A frame can sum right and still be wrong, so values out of the
+      // model's range fail like a bad checksum and are retried
+      int range_err = NO_ERROR;
+      if (!err) {
+        range_err = DHT_model_convert(model, data, &hum, &temp);
+      }
+      clock_gettime(CLOCK_MONOTONIC, &decode_end);
+      record_phase(latency, LATENCY_DECODE, &decode_start, &decode_end);
+      if (err) {
+        stage = DHT_STAGE_PARITY;
+        DHT_PROBE4(parity_fail, pin, retries, data[4],
+                   (data[0] + data[1] + data[2] + data[3]) & 0xFF);
+      } else if (range_err) {
+        err |= range_err;
+        stage = DHT_STAGE_RANGE;
+        DHT_PROBE4(range_fail, pin, retries, hum, temp);
+      } else {
+        DHT_PROBE4(frame_done, pin, retries,
+                   (data[0] << 8) | data[1], (data[2] << 8) | data[3]);
+      }
+    }
+
+    const struct hook_binding *hook =
+      __atomic_load_n(&current_hook, __ATOMIC_ACQUIRE);
+    if (hook) {
+      struct timespec hook_start, hook_end;
+      clock_gettime(CLOCK_MONOTONIC, &hook_start);
+      attempt.pin = pin;
+      attempt.attempt = retries;
+      attempt.stage = stage;
+      attempt.model = pin_models[pin];
+      attempt.cycles = cycles;
+      attempt.data = stage == DHT_STAGE_OK || stage == DHT_STAGE_PARITY ||
+                     stage == DHT_STAGE_RANGE ? data : NULL;
+      hook->hook(hook->ctx, &attempt);
+      clock_gettime(CLOCK_MONOTONIC, &hook_end);
+      hook_ns += elapsed_ns(&hook_start, &hook_end);
+    }
+
+    if (diag) {
+      if (diag->attempts < DHT_MAX_ATTEMPTS) {
+        diag->stages[diag->attempts] = stage;
+      }
+      diag->attempts++;
+    }
+
+    if (stats) {
+      stats_count_attempt(stats, pin, stage,
+                          elapsed_ns(&attempt_start, &attempt_end),
+                          err && retries + 1 < max_retries);
+    }
+
+    if (err) {
+      DHT_PROBE3(retry, pin, retries, stage);
+      struct timespec sleep_time = {0, model->cooldown_ns};
+      nanosleep(&sleep_time, NULL);
+      retries++;
+      continue;
+    }
+
+    debug_print(stdout, "%s\n", "Processed data from device!\n");
+  }  while (retries < max_retries && err);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  end = minus_ns(&end, hook_ns);
+  record_phase(latency, LATENCY_TOTAL, start, &end);
+  *attempts = err ? retries : retries + 1;
+  if (diag) {
+    diag->wall_ns = elapsed_ns(start, &end);
+    diag->realtime_priority = realtime;
+    diag->rt_ns = realtime ? elapsed_ns(&rt_start, &end) : 0;
+  }
+
+  // Max retries exceeded and there is still an error, so return it
+  if (err) {
+    return err;
+  }
+  if (stats) {
+    stats_count_success(stats, pin);
+  }
+
+  *humidity = hum;
+  *temperature = temp;
+  debug_print(stdout, "Relative humidity: %d tenths\n", hum);
+  debug_print(stdout, "Temperature: %d tenths\n", temp);
+
+  return NO_ERROR;
+}
+
+// Gets data from device as integers, recording how each attempt went in diag
+int DHT_read_tenths(const int pin, const int max_retries,
+                    int16_t *humidity, int16_t *temperature,
+                    int *attempts, struct DHT_diagnostics *diag) {
+  // Check for valid arguments
+  if (!humidity || !temperature || pin < 0 || pin >= NUM_PINS) {
+    return ERROR_INVAL;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct realtime saved;
+  enter_realtime(&saved);
+  int made;
+  int err = read_pin(pin, max_retries, humidity, temperature, &made, diag,
+                     &start, saved.raised);
+  if (attempts) {
+    *attempts = made;
+  }
+  leave_realtime(&saved);
+  return err;
+}
+
+// Gets data from device, recording how each attempt went in diag
+int DHT_read_data_diag(const int pin, const int max_retries,
+                       double *humidity, double *temperature,
+                       struct DHT_diagnostics *diag) {
+  if (!humidity || !temperature) {
+    return ERROR_INVAL;
+  }
+  int16_t hum, temp;
+  int err = DHT_read_tenths(pin, max_retries, &hum, &temp, NULL, diag);
+  if (err) {
+    return err;
+  }
+  *humidity = hum / 10.0;
+  *temperature = temp / 10.0;
+  return NO_ERROR;
+}
+
+// Reads each pin in turn, mapping the driver and raising the priority once
+// for all of them
+int DHT_read_batch(const int *pins, const int n, const int max_retries,
+                   struct DHT_reading *readings) {
+  if (!pins || !readings || n < 0) {
+    return ERROR_INVAL;
+  }
+  // A sensor can't be read twice in a row, so each pin may appear once
+  for (int i = 0; i < n; i++) {
+    if (pins[i] < 0 || pins[i] >= NUM_PINS) {
+      return ERROR_INVAL;
+    }
+    for (int j = 0; j < i; j++) {
+      if (pins[j] == pins[i]) {
+        return ERROR_INVAL;
+      }
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    readings[i].err = ERROR_DRIVER;
+    readings[i].attempts = 0;
+    readings[i].humidity = readings[i].temperature = NAN;
+    readings[i].humidity_tenths = readings[i].temperature_tenths = 0;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (DHT_open()) {
+    return ERROR_DRIVER;
+  }
+  for (int i = 0; i < n; i++) {
+    set_pull_up(&driver, pins[i]);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  for (int i = 0; i < n; i++) {
+    record_phase(latency_for(pins[i]), LATENCY_INIT, &start, &end);
+  }
+
+  struct realtime saved;
+  enter_realtime(&saved);
+  for (int i = 0; i < n; i++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct DHT_reading *reading = &readings[i];
+    reading->err = read_pin(pins[i], max_retries, &reading->humidity_tenths,
+                            &reading->temperature_tenths, &reading->attempts,
+                            NULL, &start, saved.raised);
+    if (!reading->err) {
+      reading->humidity = reading->humidity_tenths / 10.0;
+      reading->temperature = reading->temperature_tenths / 10.0;
+    }
+  }
+  leave_realtime(&saved);
+  DHT_close();
+  return NO_ERROR;
+}
+
+int DHT_set_latency(const int pin, struct latency_set *latency) {
+  if (pin < 0 || pin >= NUM_PINS) {
+    return ERROR_INVAL;
+  }
+  latency_sets[pin] = latency;
+  return NO_ERROR;
+}
+
+int DHT_set_model(const int pin, const int model) {
+  if (pin < 0 || pin >= NUM_PINS || !DHT_model_info(model)) {
+    return ERROR_INVAL;
+  }
+  pin_models[pin] = model;
+  return NO_ERROR;
+}
+
+int DHT_set_attempt_hook(DHT_attempt_hook hook, void *ctx) {
+  const struct hook_binding *binding = NULL;
+  int err = NO_ERROR;
+  pthread_mutex_lock(&hook_lock);
+  for (int i = 0; hook && i < nhook_bindings && !binding; i++) {
+    if (hook_bindings[i].hook == hook && hook_bindings[i].ctx == ctx) {
+      binding = &hook_bindings[i];
+    }
+  }
+  if (hook && !binding) {
+    if (nhook_bindings < MAX_ATTEMPT_HOOKS) {
+      hook_bindings[nhook_bindings] = (struct hook_binding){hook, ctx};
+      binding = &hook_bindings[nhook_bindings++];
+    } else {
+      err = ERROR_INVAL;
+    }
+  }
+  if (!err) {
+    __atomic_store_n(&current_hook, binding, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&hook_lock);
+  return err;
+}
+
+void DHT_set_stats(struct stats_file *stats) {
+  stats_file = stats;
+}
+
+const char *DHT_stage_str(int stage) {
+  switch (stage) {
+    case DHT_STAGE_OK:
+      return "ok";
+    case DHT_STAGE_RESPONSE_LOW:
+      return "no response low";
+    case DHT_STAGE_RESPONSE_HIGH:
+      return "no response high";
+    case DHT_STAGE_BITS:
+      return "bit timeout";
+    case DHT_STAGE_PARITY:
+      return "parity";
+    case DHT_STAGE_RANGE:
+      return "out of range";
+    default:
+      return "unknown";
+  }
+}
+
+// Gets data from device as integers, then checks it against the outlier
+// filter, which works in the same tenths
+int DHT_read_filtered_tenths(const int pin, const int max_retries,
+                             struct filter *filter,
+                             int16_t *humidity, int16_t *temperature,
+                             int *reason, int *attempts,
+                             struct DHT_diagnostics *diag) {
+  if (!filter || !reason) {
+    return ERROR_INVAL;
+  }
+
+  int err = DHT_read_tenths(pin, max_retries, humidity, temperature, attempts,
+                            diag);
+  if (err) {
+    return err;
+  }
+
+  *reason = filter_update(filter, *temperature, *humidity);
+  if (*reason) {
+    debug_print(stderr, "%s\n", filter_reason_str(*reason));
+  }
+  return NO_ERROR;
+}
+
+// Gets data from device, then checks it against the outlier filter
+int DHT_read_filtered(const int pin, const int max_retries,
+                      struct filter *filter,
+                      double *humidity, double *temperature,
+                      int *reason, struct DHT_diagnostics *diag) {
+  if (!humidity || !temperature) {
+    return ERROR_INVAL;
+  }
+  int16_t hum, temp;
+  int err = DHT_read_filtered_tenths(pin, max_retries, filter, &hum, &temp,
+                                     reason, NULL, diag);
+  if (err) {
+    return err;
+  }
+  *humidity = hum / 10.0;
+  *temperature = temp / 10.0;
+  return NO_ERROR;
+}
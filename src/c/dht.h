@@ -1,51 +1,211 @@
-#ifndef DHT
-#define DHT
-
-// Print function that only prints if DEBUG is defined
-#ifdef DEBUG
-#define DEBUG_PRINT 1
-#else
-#define DEBUG_PRINT 0
-#endif
-#define debug_print(fd, fmt, ...) \
-            do { if (DEBUG_PRINT) fprintf(fd, fmt, __VA_ARGS__); } while (0)
-
-// Errors
-enum Error {
-  NO_ERROR,
-  ERROR_TIME,        // Timeout
-  ERROR_DRIVER,      // Driver failed to init
-  ERROR_PARITY,      // Checksum failed
-  ERROR_INVAL,       // Invalid argument
-};
-
-// Pin defines
-#define DHT_PIN 4
-
-// Defaults
-#define RETRIES 30
-#define NUM_BITS 40 // Sensor returns 40 bits of data
-#define NUM_BYTES 5 // Which is 5 bytes
-
-// Timing defines
-#define HOST_STARTSIG_LOW_TIME_US 1000  // Start signal, typical 1ms
-#define HOST_STARTSIG_WAIT_TIME_US 25   // Wait time for response from sensor, 20-30us
-
-#define SENSOR_WAIT_TIME_US 45          // Wait time for sensor to pull data line up/down
-#define SENSOR_WAIT_TIME_CYCLES 10000   // Number of iterations in loop to wait for sensor to pull data line up/down
-#define TIMEOUT_CYCLES 50000            // Max number of iterations in loop to wait after sensor has pulled data line up/down
-
-#define SENSOR_COOLDOWN_TIME_US 500000  // Trial and error magic number to reset sensor
-#define SENSOR_COOLDOWN_TIME_NS 500000000
-
-// Set up and tear down BCM2835 driver
-int DHT_init(const int pin);
-int DHT_deinit(void);
-
-// Read data from DHT22
-int DHT_read_data(const int pin,
-                  const int max_retries,
-                  double *humidity,
-                  double *temperature);
-
+#ifndef DHT
+#define DHT
+
+#include <stdint.h>
+#include <time.h>
+
+// Print function that only prints if DEBUG is defined
+#ifdef DEBUG
+#define DEBUG_PRINT 1
+#else
+#define DEBUG_PRINT 0
+#endif
+#define debug_print(fd, fmt, ...) \
+            do { if (DEBUG_PRINT) fprintf(fd, fmt, __VA_ARGS__); } while (0)
+
+// Errors
+enum Error {
+  NO_ERROR,
+  ERROR_TIME,        // Timeout
+  ERROR_DRIVER,      // Driver failed to init
+  ERROR_PARITY,      // Checksum failed
+  ERROR_INVAL,       // Invalid argument
+};
+
+// Pin defines
+#define DHT_PIN 4
+#define NUM_PINS 54 // BCM2835 GPIO pins
+
+// Defaults
+#define RETRIES 30
+#define NUM_BITS 40 // Sensor returns 40 bits of data
+#define NUM_BYTES 5 // Which is 5 bytes
+
+// Timing defines
+// The start signal's low depends on the sensor; see model.h
+#define HOST_STARTSIG_WAIT_TIME_US 25   // Wait time for response from sensor, 20-30us
+
+#define SENSOR_WAIT_TIME_US 45          // Wait time for sensor to pull data line up/down
+#define SENSOR_WAIT_TIME_CYCLES 10000   // Number of iterations in loop to wait for sensor to pull data line up/down
+#define TIMEOUT_CYCLES 50000            // Max number of iterations in loop to wait after sensor has pulled data line up/down
+
+#define SENSOR_COOLDOWN_TIME_NS 500000000L  // Trial and error magic number to reset sensor
+
+#define DHT_MAX_ATTEMPTS 64             // Attempts whose outcome is kept in diagnostics
+#define MAX_ATTEMPT_HOOKS 16            // Different hook and ctx pairs, see DHT_set_attempt_hook
+
+// Outcome of a single attempt to read the sensor
+enum DHT_stage {
+  DHT_STAGE_OK,
+  DHT_STAGE_RESPONSE_LOW,  // Sensor didn't pull line low after start signal
+  DHT_STAGE_RESPONSE_HIGH, // Sensor didn't release line after pulling it low
+  DHT_STAGE_BITS,          // A data bit timed out
+  DHT_STAGE_PARITY,        // Checksum failed
+  DHT_STAGE_RANGE,         // Checksum matched, values out of the model's range
+};
+
+// Details of a read, filled by DHT_read_data_diag
+// Cycles are iterations of the polling loop; bits_ns / (sum of all bit
+// cycles) gives their length in ns on this board
+struct DHT_diagnostics {
+  int attempts;
+  uint8_t stages[DHT_MAX_ATTEMPTS];  // enum DHT_stage of each attempt
+  int64_t wall_ns;                   // Total time spent reading
+  int64_t rt_ns;                     // Time spent at real-time priority
+  int realtime_priority;             // Whether SCHED_FIFO could be set
+
+  // Of the last attempt that got as far as the data bits
+  uint16_t ack_low_cycles;           // Sensor response, low then high
+  uint16_t ack_high_cycles;
+  uint16_t low_cycles[NUM_BITS];
+  uint16_t high_cycles[NUM_BITS];
+  int64_t bits_ns;                   // Time spent capturing the bits
+  int min_margin;                    // Smallest |high - low| of any bit, cycles
+  int min_margin_bit;                // Bit with the smallest margin
+  struct timespec monotonic;         // When the bits were captured
+  struct timespec realtime;
+};
+
+// Set up and tear down BCM2835 driver
+// The driver is shared by every thread: it is mapped by the first DHT_open
+// and unmapped by the matching last DHT_close, so threads reading different
+// pins don't unmap each other's registers. Reading the same pin from two
+// threads at once is still up to the caller to prevent
+int DHT_open(void);
+int DHT_close(void);
+
+// DHT_open, then set up pin; each DHT_init that succeeded needs a DHT_deinit
+int DHT_init(const int pin);
+int DHT_deinit(void);
+
+// Read data from DHT22
+int DHT_read_data(const int pin,
+                  const int max_retries,
+                  double *humidity,
+                  double *temperature);
+
+// Capture one frame into cycles, NUM_BITS * 2 low/high poll counts, without
+// retries, priority changes or decoding; DHT_init must have been called
+// OUT: stage, the enum DHT_stage at which the capture failed
+int DHT_capture(const int pin, int *cycles, int *stage);
+
+// Read data from the sensor as it sends it, in tenths of % and of deg C,
+// filling diag with timing and the outcome of each attempt; diag may be NULL
+// OUT: attempts, if not NULL, the number of attempts made, also on failure
+// Frames whose values are out of the model's range fail like a bad checksum,
+// see DHT_model_convert. The functions returning doubles wrap this
+int DHT_read_tenths(const int pin,
+                    const int max_retries,
+                    int16_t *humidity,
+                    int16_t *temperature,
+                    int *attempts,
+                    struct DHT_diagnostics *diag);
+
+// Read data from DHT22, filling diag with timing and the outcome of each
+// attempt; diag may be NULL
+int DHT_read_data_diag(const int pin,
+                       const int max_retries,
+                       double *humidity,
+                       double *temperature,
+                       struct DHT_diagnostics *diag);
+
+// Outcome of reading one pin of a batch
+struct DHT_reading {
+  int err;                           // enum Error
+  int attempts;
+  double temperature;                // NaN unless err is NO_ERROR
+  double humidity;
+  int16_t temperature_tenths;        // 0 unless err is NO_ERROR
+  int16_t humidity_tenths;
+};
+
+// Read every one of n pins in turn, filling readings[i] for pins[i]
+// The driver is set up, and the priority raised, once for the whole batch
+// rather than once per pin
+// Returns ERROR_INVAL if a pin is out of range or repeated, ERROR_DRIVER if
+// the driver couldn't be set up, and otherwise NO_ERROR, whatever the err of
+// each reading
+int DHT_read_batch(const int *pins,
+                   const int n,
+                   const int max_retries,
+                   struct DHT_reading *readings);
+
+// Read data from DHT22 and check it against the outlier filter
+// OUT: reason, FILTER_ACCEPTED or a mask of why the reading was rejected
+// diag may be NULL
+struct filter;
+int DHT_read_filtered(const int pin,
+                      const int max_retries,
+                      struct filter *filter,
+                      double *humidity,
+                      double *temperature,
+                      int *reason,
+                      struct DHT_diagnostics *diag);
+
+// DHT_read_filtered in tenths, see DHT_read_tenths
+int DHT_read_filtered_tenths(const int pin,
+                             const int max_retries,
+                             struct filter *filter,
+                             int16_t *humidity,
+                             int16_t *temperature,
+                             int *reason,
+                             int *attempts,
+                             struct DHT_diagnostics *diag);
+
+// Record the duration of each phase of reads on pin into latency, or stop
+// recording if latency is NULL; latency must outlive its registration
+struct latency_set;
+int DHT_set_latency(const int pin, struct latency_set *latency);
+
+// Read pin as the enum DHT_model model, see model.h; pins are DHT22 until set
+// Returns ERROR_INVAL if pin or model is out of range
+int DHT_set_model(const int pin, const int model);
+
+// Raw timings of one attempt, passed to the attempt hook
+// cycles are all zero if the sensor didn't respond (stage _RESPONSE_LOW or
+// _RESPONSE_HIGH); if a bit timed out (_BITS), that level reads
+// TIMEOUT_CYCLES and the counts after it are whatever the line did next.
+// data is NULL unless the bits were decoded, i.e. stage is DHT_STAGE_OK,
+// _PARITY or _RANGE
+struct DHT_attempt {
+  int pin;
+  int attempt;                       // 0 for the first attempt of a read
+  int stage;                         // enum DHT_stage
+  int model;                         // enum DHT_model of the pin
+  int ack_low_cycles;
+  int ack_high_cycles;
+  int64_t bits_ns;                   // Time taken by the 40 bits, if captured
+  const int *cycles;                 // NUM_BITS * 2 low/high counts
+  const uint8_t *data;               // NUM_BYTES as decoded
+};
+
+typedef void (*DHT_attempt_hook)(void *ctx, const struct DHT_attempt *attempt);
+
+// Call hook after every attempt of every read, e.g. to record raw timings,
+// or stop if hook is NULL; the hook runs between attempts, and the time it
+// takes is left out of the total latency and of wall_ns and rt_ns
+// Safe while other threads read: each attempt calls either the old hook
+// with the old ctx or the new one with the new ctx, so the old ctx must
+// stay valid until reads in progress end. Returns ERROR_INVAL once
+// MAX_ATTEMPT_HOOKS different hook and ctx pairs have been set
+int DHT_set_attempt_hook(DHT_attempt_hook hook, void *ctx);
+
+// Count reads, attempts and failures of every pin in stats, or stop
+// counting if stats is NULL
+struct stats_file;
+void DHT_set_stats(struct stats_file *stats);
+
+// Short name of an enum DHT_stage
+const char *DHT_stage_str(int stage);
+
 #endif
\ No newline at end of file
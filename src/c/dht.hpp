@@ -0,0 +1,237 @@
+#ifndef DHT_HPP
+#define DHT_HPP
+
+extern "C" {
+#include "dht.h"
+#include "filter.h"
+}
+
+#include <cstdint>
+#include <utility>
+
+// C++ ownership of the driver and of pins, over dht.h
+//
+// Session holds a reference to the driver (DHT_open/DHT_close) and Pin one
+// configured pin (DHT_init/DHT_deinit). Both are move-only and release what
+// they hold exactly once, on destruction or close(), so an early return
+// can't leak the mapping or close it twice. Nothing here allocates; results
+// come back as an Expected holding either the value or the enum Error.
+
+namespace dht {
+
+// Error of a failed operation, converting to any Expected
+struct Failure {
+  int err;
+};
+
+inline Failure fail(int err) {
+  return Failure{err};
+}
+
+// Either a value or the enum Error that prevented it, like std::expected
+template <class T>
+class Expected {
+ public:
+  Expected(T value) : err(NO_ERROR), val(std::move(value)) {
+  }
+  Expected(Failure failure) : err(failure.err), val() {
+  }
+
+  explicit operator bool() const {
+    return err == NO_ERROR;
+  }
+  int error() const {
+    return err;
+  }
+
+  // The value; only meaningful if there is no error
+  T &operator*() {
+    return val;
+  }
+  const T &operator*() const {
+    return val;
+  }
+  T *operator->() {
+    return &val;
+  }
+  const T *operator->() const {
+    return &val;
+  }
+
+ private:
+  int err;
+  T val;
+};
+
+// A decoded reading, in tenths as the sensor sends it
+struct Reading {
+  int16_t temperatureTenths = 0;
+  int16_t humidityTenths = 0;
+
+  double temperature() const {
+    return temperatureTenths / 10.0;
+  }
+  double humidity() const {
+    return humidityTenths / 10.0;
+  }
+};
+
+// A pin set up for reading; holds the driver while it lives
+class Pin {
+ public:
+  // Holds nothing
+  Pin() : number(-1) {
+  }
+
+  // Sets up pin, e.g. its pull-up; ERROR_INVAL if it isn't a GPIO pin,
+  // ERROR_DRIVER if the driver can't be set up
+  static Expected<Pin> open(int pin) {
+    if (pin < 0 || pin >= NUM_PINS) {
+      return fail(ERROR_INVAL);
+    }
+    int err = DHT_init(pin);
+    if (err) {
+      return fail(err);
+    }
+    return Pin(pin);
+  }
+
+  Pin(Pin &&other) noexcept : number(other.number) {
+    other.number = -1;
+  }
+  Pin &operator=(Pin &&other) noexcept {
+    if (this != &other) {
+      close();
+      number = other.number;
+      other.number = -1;
+    }
+    return *this;
+  }
+  Pin(const Pin &) = delete;
+  Pin &operator=(const Pin &) = delete;
+
+  ~Pin() {
+    close();
+  }
+
+  // Releases the driver now rather than on destruction
+  void close() {
+    if (number >= 0) {
+      DHT_deinit();
+      number = -1;
+    }
+  }
+
+  // GPIO number, or -1 if closed
+  int pin() const {
+    return number;
+  }
+
+  // See DHT_read_tenths; diag and attempts may be NULL
+  Expected<Reading> read(int retries, struct DHT_diagnostics *diag = NULL,
+                         int *attempts = NULL) const {
+    if (number < 0) {
+      return fail(ERROR_INVAL);
+    }
+    Reading reading;
+    int err = DHT_read_tenths(number, retries, &reading.humidityTenths,
+                              &reading.temperatureTenths, attempts, diag);
+    if (err) {
+      return fail(err);
+    }
+    return reading;
+  }
+
+  // See DHT_read_filtered_tenths; the reading comes back even if rejected,
+  // with reason set to why
+  Expected<Reading> readFiltered(int retries, struct filter &filter,
+                                 int &reason,
+                                 struct DHT_diagnostics *diag = NULL,
+                                 int *attempts = NULL) const {
+    if (number < 0) {
+      return fail(ERROR_INVAL);
+    }
+    Reading reading;
+    int err = DHT_read_filtered_tenths(number, retries, &filter,
+                                       &reading.humidityTenths,
+                                       &reading.temperatureTenths, &reason,
+                                       attempts, diag);
+    if (err) {
+      return fail(err);
+    }
+    return reading;
+  }
+
+ private:
+  explicit Pin(int pin) : number(pin) {
+  }
+
+  int number;
+};
+
+// A reference to the driver, keeping it mapped across reads and pins
+class Session {
+ public:
+  // Holds nothing
+  Session() : held(false) {
+  }
+
+  // ERROR_DRIVER if the driver can't be set up
+  static Expected<Session> open() {
+    int err = DHT_open();
+    if (err) {
+      return fail(err);
+    }
+    return Session(true);
+  }
+
+  Session(Session &&other) noexcept : held(other.held) {
+    other.held = false;
+  }
+  Session &operator=(Session &&other) noexcept {
+    if (this != &other) {
+      close();
+      held = other.held;
+      other.held = false;
+    }
+    return *this;
+  }
+  Session(const Session &) = delete;
+  Session &operator=(const Session &) = delete;
+
+  ~Session() {
+    close();
+  }
+
+  void close() {
+    if (held) {
+      DHT_close();
+      held = false;
+    }
+  }
+
+  bool isOpen() const {
+    return held;
+  }
+
+  // See Pin::open; opening the pin maps nothing anew while this is open
+  Expected<Pin> pin(int pin) const {
+    return Pin::open(pin);
+  }
+
+  // See DHT_read_batch; each reading has its own err
+  int readBatch(const int *pins, int n, int retries,
+                struct DHT_reading *readings) const {
+    return DHT_read_batch(pins, n, retries, readings);
+  }
+
+ private:
+  explicit Session(bool held) : held(held) {
+  }
+
+  bool held;
+};
+
+}
+
+#endif
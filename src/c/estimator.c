@@ -0,0 +1,66 @@
+#include "estimator.h"
+
+#include <math.h>
+#include <string.h>
+
+static void kalman_init(struct kalman *k, double q, double r) {
+  memset(k, 0, sizeof(*k));
+  k->q = q;
+  k->r = r;
+}
+
+// Predicts dt seconds ahead and corrects with measurement z
+// Returns the innovation in standard deviations of its prediction
+static double kalman_update(struct kalman *k, double z, double dt) {
+  if (!k->initialised) {
+    k->x = z;
+    k->p = k->r;
+    k->initialised = 1;
+    return 0;
+  }
+
+  k->p += k->q * dt;
+  double s = k->p + k->r;
+  double y = z - k->x;
+  double gain = k->p / s;
+  k->x += gain * y;
+  k->p *= 1 - gain;
+  return fabs(y) / sqrt(s);
+}
+
+void estimator_init(struct estimator *est,
+                    double min_interval, double max_interval) {
+  memset(est, 0, sizeof(*est));
+  kalman_init(&est->temp, ESTIMATOR_TEMP_Q, ESTIMATOR_TEMP_R);
+  kalman_init(&est->hum, ESTIMATOR_HUM_Q, ESTIMATOR_HUM_R);
+  est->min_interval = min_interval < ESTIMATOR_MIN_INTERVAL
+                      ? ESTIMATOR_MIN_INTERVAL : min_interval;
+  est->max_interval = max_interval > 0 ? max_interval : ESTIMATOR_MAX_INTERVAL;
+  if (est->max_interval < est->min_interval) {
+    est->max_interval = est->min_interval;
+  }
+  est->interval = est->min_interval;
+}
+
+double estimator_update(struct estimator *est, double now,
+                        double temperature, double humidity) {
+  double dt = est->temp.initialised ? now - est->last_time : 0;
+  if (dt < 0) {
+    dt = 0;
+  }
+  est->last_time = now;
+
+  double temp_sigma = kalman_update(&est->temp, temperature, dt);
+  double hum_sigma = kalman_update(&est->hum, humidity, dt);
+  double sigma = temp_sigma > hum_sigma ? temp_sigma : hum_sigma;
+
+  if (sigma > ESTIMATOR_JUMP_SIGMA) {
+    est->interval = est->min_interval;
+  } else if (sigma < ESTIMATOR_CALM_SIGMA) {
+    est->interval *= ESTIMATOR_GROWTH;
+  }
+  if (est->interval > est->max_interval) {
+    est->interval = est->max_interval;
+  }
+  return est->interval;
+}
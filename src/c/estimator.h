@@ -0,0 +1,51 @@
+#ifndef ESTIMATOR
+#define ESTIMATOR
+
+// Kalman-smoothed temperature and humidity with an adaptive read interval
+//
+// Each quantity is tracked by a 1-D Kalman filter with a random-walk model,
+// whose process noise grows with the time between reads. The innovation of
+// each read, normalised by its predicted standard deviation, drives the read
+// interval: while readings stay within ESTIMATOR_CALM_SIGMA of prediction
+// the interval grows towards the maximum, and a jump beyond
+// ESTIMATOR_JUMP_SIGMA drops it straight to the minimum.
+
+#define ESTIMATOR_MIN_INTERVAL 2.0      // Seconds; DHT22 cannot be read faster
+#define ESTIMATOR_MAX_INTERVAL 600.0
+#define ESTIMATOR_CALM_SIGMA 1.0
+#define ESTIMATOR_JUMP_SIGMA 3.0
+#define ESTIMATOR_GROWTH 1.5            // Interval multiplier while calm
+
+// Noise model for the DHT22
+#define ESTIMATOR_TEMP_Q 1e-4           // Process noise, (deg C)^2 per second
+#define ESTIMATOR_TEMP_R 0.04           // Measurement noise, (deg C)^2
+#define ESTIMATOR_HUM_Q 1e-3            // %^2 per second
+#define ESTIMATOR_HUM_R 1.0             // %^2
+
+struct kalman {
+  double x;               // Estimate
+  double p;               // Variance of estimate
+  double q;               // Process noise per second
+  double r;               // Measurement noise
+  int initialised;
+};
+
+struct estimator {
+  struct kalman temp;
+  struct kalman hum;
+  double last_time;       // Seconds, monotonic
+  double interval;        // Seconds until next read
+  double min_interval;
+  double max_interval;
+};
+
+// Values of 0 or less select the defaults
+void estimator_init(struct estimator *est,
+                    double min_interval, double max_interval);
+
+// Feed a reading taken at time now (seconds, monotonic)
+// Returns the number of seconds to wait before the next read
+double estimator_update(struct estimator *est, double now,
+                        double temperature, double humidity);
+
+#endif
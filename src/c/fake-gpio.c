@@ -0,0 +1,119 @@
+#include "fake-gpio.h"
+
+#include "bcm2835.h"
+#include "dht.h"
+
+// Polls after release before the sensor responds, and of its final low
+#define RELEASE_POLLS 100
+#define END_LOW_POLLS 250
+
+// Nominal polls of the response, a bit's low, and a 0 and a 1's high
+#define ACK_POLLS 400
+#define LOW_POLLS 250
+#define ZERO_POLLS 130
+#define ONE_POLLS 350
+
+struct segment {
+  uint8_t level;
+  int polls;
+};
+
+static struct segment script[FAKE_GPIO_MAX_SEGMENTS];
+static int nsegments;
+static int current;
+static int remaining;
+static uint64_t polls;
+
+void fake_gpio_load(int ack_low, int ack_high, const int *cycles) {
+  nsegments = 0;
+  script[nsegments++] = (struct segment){HIGH, RELEASE_POLLS};
+  script[nsegments++] = (struct segment){LOW, ack_low};
+  script[nsegments++] = (struct segment){HIGH, ack_high};
+  for (int i = 0; i < NUM_BITS * 2; i++) {
+    script[nsegments++] = (struct segment){i % 2 ? HIGH : LOW, cycles[i]};
+  }
+  script[nsegments++] = (struct segment){LOW, END_LOW_POLLS};
+  current = nsegments;
+  polls = 0;
+}
+
+void fake_gpio_sensor(double temperature, double humidity) {
+  // Sign and magnitude, in tenths
+  int hum = (int)(humidity * 10 + 0.5);
+  int temp = (int)((temperature < 0 ? -temperature : temperature) * 10 + 0.5);
+  uint8_t data[NUM_BYTES] = {
+    hum >> 8, hum & 0xFF,
+    ((temp >> 8) & 0x7F) | (temperature < 0 ? 0x80 : 0), temp & 0xFF,
+  };
+  data[4] = data[0] + data[1] + data[2] + data[3];
+
+  int cycles[NUM_BITS * 2];
+  for (int i = 0; i < NUM_BITS; i++) {
+    cycles[i*2] = LOW_POLLS;
+    cycles[i*2+1] = (data[i/8] >> (7 - i%8)) & 1 ? ONE_POLLS : ZERO_POLLS;
+  }
+  fake_gpio_load(ACK_POLLS, ACK_POLLS, cycles);
+}
+
+uint64_t fake_gpio_polls(void) {
+  return polls;
+}
+
+// Line idles high, pulled up, outside the script
+uint8_t bcm2835_ctx_gpio_lev(const struct bcm2835_ctx *ctx, uint8_t pin) {
+  (void)ctx;
+  (void)pin;
+  polls++;
+  if (current >= nsegments) {
+    return HIGH;
+  }
+  uint8_t level = script[current].level;
+  if (--remaining <= 0 && ++current < nsegments) {
+    remaining = script[current].polls;
+  }
+  return level;
+}
+
+void bcm2835_ctx_gpio_fsel(const struct bcm2835_ctx *ctx, uint8_t pin, uint8_t mode) {
+  (void)ctx;
+  (void)pin;
+  if (mode == BCM2835_GPIO_FSEL_INPT) {
+    current = 0;
+    remaining = script[0].polls;
+  }
+}
+
+void bcm2835_ctx_gpio_set(const struct bcm2835_ctx *ctx, uint8_t pin) {
+  (void)ctx;
+  (void)pin;
+}
+
+void bcm2835_ctx_gpio_clr(const struct bcm2835_ctx *ctx, uint8_t pin) {
+  (void)ctx;
+  (void)pin;
+}
+
+void bcm2835_ctx_gpio_set_pud(const struct bcm2835_ctx *ctx, uint8_t pin, uint8_t pud) {
+  (void)ctx;
+  (void)pin;
+  (void)pud;
+}
+
+void bcm2835_ctx_delayMicroseconds(const struct bcm2835_ctx *ctx, uint64_t micros) {
+  (void)ctx;
+  (void)micros;
+}
+
+int bcm2835_ctx_open(struct bcm2835_ctx *ctx, uint8_t debug) {
+  (void)ctx;
+  (void)debug;
+  if (!nsegments) {
+    fake_gpio_sensor(FAKE_GPIO_TEMPERATURE, FAKE_GPIO_HUMIDITY);
+  }
+  return 1;
+}
+
+int bcm2835_ctx_close(struct bcm2835_ctx *ctx) {
+  (void)ctx;
+  return 1;
+}
@@ -0,0 +1,28 @@
+#ifndef FAKE_GPIO
+#define FAKE_GPIO
+
+#include <stdint.h>
+
+// Scripted stand-in for the bcm2835 GPIO functions used by dht.c, so the
+// capture loop can run without a sensor. Each bcm2835_ctx_gpio_lev call
+// consumes one poll of the script, which starts when the pin is switched to
+// input at the end of the start signal.
+
+#define FAKE_GPIO_MAX_SEGMENTS 96
+#define FAKE_GPIO_TEMPERATURE 21.5
+#define FAKE_GPIO_HUMIDITY 45.0
+
+// Loads the waveform of one frame: the sensor's response low and high, then
+// low/high poll counts for each of the 40 bits as in DHT_process_data
+void fake_gpio_load(int ack_low, int ack_high, const int *cycles);
+
+// Loads a frame sending temperature and humidity at nominal timings, so the
+// fake behaves like a steady sensor; bcm2835_ctx_open loads one if no frame is
+// loaded yet, so code built against the fake, e.g. the binding with the
+// simulator backend, reads FAKE_GPIO_TEMPERATURE and FAKE_GPIO_HUMIDITY
+void fake_gpio_sensor(double temperature, double humidity);
+
+// Number of polls made since the last load
+uint64_t fake_gpio_polls(void);
+
+#endif
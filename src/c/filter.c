@@ -0,0 +1,89 @@
+#include "filter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Scales the MAD to the standard deviation of normally distributed data
+#define MAD_SCALE 1.4826
+
+// Sorts a small array in place
+static void insertion_sort(int16_t *values, int n) {
+  for (int i = 1; i < n; i++) {
+    int16_t v = values[i];
+    int j = i - 1;
+    while (j >= 0 && values[j] > v) {
+      values[j + 1] = values[j];
+      j--;
+    }
+    values[j + 1] = v;
+  }
+}
+
+// Median of a sorted array, doubled to stay in integers
+static int median2(const int16_t *sorted, int n) {
+  return n % 2 ? 2 * sorted[n / 2] : sorted[n / 2 - 1] + sorted[n / 2];
+}
+
+// Returns whether value is an outlier against the window, then adds it
+static int hampel_update(struct hampel *h, uint8_t window, double threshold,
+                         int16_t min_dev, int16_t value) {
+  int outlier = 0;
+
+  if (h->len >= FILTER_MIN_SAMPLES) {
+    int16_t sorted[FILTER_MAX_WINDOW];
+    memcpy(sorted, h->values, h->len * sizeof(int16_t));
+    insertion_sort(sorted, h->len);
+    int med2 = median2(sorted, h->len);
+
+    // Absolute deviations, also doubled
+    for (int i = 0; i < h->len; i++) {
+      sorted[i] = abs(2 * sorted[i] - med2);
+    }
+    insertion_sort(sorted, h->len);
+    double mad = median2(sorted, h->len) / 4.0;
+
+    double dev = abs(2 * value - med2) / 2.0;
+    outlier = dev > threshold * MAD_SCALE * mad && dev > min_dev;
+  }
+
+  h->values[h->next] = value;
+  h->next = (h->next + 1) % window;
+  if (h->len < window) {
+    h->len++;
+  }
+  return outlier;
+}
+
+void filter_init(struct filter *filter, int window, double threshold,
+                 int temp_min_dev, int hum_min_dev) {
+  memset(filter, 0, sizeof(*filter));
+  if (window <= 0) {
+    window = FILTER_WINDOW;
+  }
+  filter->window = window > FILTER_MAX_WINDOW ? FILTER_MAX_WINDOW : window;
+  filter->threshold = threshold < 0 ? FILTER_THRESHOLD : threshold;
+  filter->temp_min_dev = temp_min_dev < 0 ? FILTER_TEMP_MIN_DEV : temp_min_dev;
+  filter->hum_min_dev = hum_min_dev < 0 ? FILTER_HUM_MIN_DEV : hum_min_dev;
+}
+
+int filter_update(struct filter *filter, int16_t temp, int16_t hum) {
+  int reason = FILTER_ACCEPTED;
+  if (hampel_update(&filter->temp, filter->window, filter->threshold,
+                    filter->temp_min_dev, temp)) {
+    reason |= FILTER_TEMP_OUTLIER;
+  }
+  if (hampel_update(&filter->hum, filter->window, filter->threshold,
+                    filter->hum_min_dev, hum)) {
+    reason |= FILTER_HUM_OUTLIER;
+  }
+  return reason;
+}
+
+const char *filter_reason_str(int reason) {
+  switch (reason) {
+    case FILTER_ACCEPTED: return "Accepted";
+    case FILTER_TEMP_OUTLIER: return "Temperature outlier";
+    case FILTER_HUM_OUTLIER: return "Humidity outlier";
+    default: return "Temperature and humidity outlier";
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef FILTER
+#define FILTER
+
+#include <stdint.h>
+
+// Streaming Hampel outlier filter for temperature and humidity
+//
+// Each quantity keeps a window of its most recent readings. A reading is an
+// outlier if it is further from the window median than both threshold times
+// the scaled median absolute deviation and a fixed minimum deviation.
+// Every reading enters the window, rejected or not, so a genuine step change
+// is accepted once it makes up half the window, and a bad first reading
+// cannot hold back later good ones. Work per reading is bounded by the
+// window size, at most FILTER_MAX_WINDOW.
+
+#define FILTER_MAX_WINDOW 31
+#define FILTER_MIN_SAMPLES 3        // Readings needed before anything is rejected
+
+// Defaults
+#define FILTER_WINDOW 7
+#define FILTER_THRESHOLD 3.0        // In scaled MADs
+#define FILTER_TEMP_MIN_DEV 50      // Tenths of deg C
+#define FILTER_HUM_MIN_DEV 50       // Tenths of %
+
+// Reasons for rejection, as a bitmask
+enum filter_reason {
+  FILTER_ACCEPTED = 0,
+  FILTER_TEMP_OUTLIER = 1 << 0,
+  FILTER_HUM_OUTLIER = 1 << 1,
+};
+
+struct hampel {
+  int16_t values[FILTER_MAX_WINDOW];
+  uint8_t len;            // Number of values held
+  uint8_t next;           // Slot the next value goes into
+};
+
+struct filter {
+  uint8_t window;
+  double threshold;
+  int16_t temp_min_dev;
+  int16_t hum_min_dev;
+  struct hampel temp;
+  struct hampel hum;
+};
+
+// Reset the filter; window of 0 and thresholds below 0 select the defaults
+void filter_init(struct filter *filter, int window, double threshold,
+                 int temp_min_dev, int hum_min_dev);
+
+// Check a reading in tenths against the window and add it
+// Returns FILTER_ACCEPTED or a mask of enum filter_reason
+int filter_update(struct filter *filter, int16_t temp, int16_t hum);
+
+// Describe a rejection mask
+const char *filter_reason_str(int reason);
+
+#endif
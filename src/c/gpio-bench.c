@@ -0,0 +1,157 @@
+#include "bcm2835.h"
+#include "capture_engine.h"
+#include "dht.h"
+#include "gpio_fast.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Polling rate of each way of reading a pin's level
+//
+// Runs the loop of level_cycles in dht.c, counting polls while the pin is
+// high, with the pin read through the legacy bcm2835_gpio_lev, through
+// bcm2835_ctx_gpio_lev, through the inline gpio_line, and in the loop
+// compiled for the pin by capture_engine.cpp, as dht.c now does. The GPIO
+// registers are ordinary memory, so this runs anywhere; on a Pi the loads
+// reach the peripheral bus instead, which makes every poll slower, but
+// the call and barrier overhead removed is the same.
+//
+// gpio-bench [-n polls]
+
+#define POLLS 10000000
+#define RUN TIMEOUT_CYCLES      // Polls per run, as for one level of a bit
+#define BENCH_PIN DHT_PIN
+#define GPIO_WORDS 64
+
+static uint32_t registers[GPIO_WORDS];
+
+static double now_s(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int run_legacy(void) {
+  int count = 0;
+  while (bcm2835_gpio_lev(BENCH_PIN) == HIGH && count < RUN) {
+    ++count;
+  }
+  return count;
+}
+
+static int run_ctx(const struct bcm2835_ctx *ctx) {
+  int count = 0;
+  while (bcm2835_ctx_gpio_lev(ctx, BENCH_PIN) == HIGH && count < RUN) {
+    ++count;
+  }
+  return count;
+}
+
+// A pin's GPLEV register and bit, resolved once so that each sample is
+// one load and a mask; what dht.c polled through before capture_engine.hpp
+struct gpio_line {
+  const struct bcm2835_ctx *ctx;
+  volatile uint32_t *lev;         // GPLEV register of the pin's bank
+  uint32_t mask;                  // Bit of the pin in it
+  uint8_t pin;
+};
+
+static inline struct gpio_line gpio_line_open(const struct bcm2835_ctx *ctx,
+                                              const uint8_t pin) {
+  struct gpio_line line = {
+    ctx, ctx->gpio + BCM2835_GPLEV0/4 + pin/32, 1u << (pin % 32), pin,
+  };
+  return line;
+}
+
+// Whether line is at level, HIGH or LOW
+static inline int gpio_line_is(const struct gpio_line *line, const uint8_t level) {
+#ifdef DHT_SIMULATOR
+  return bcm2835_ctx_gpio_lev(line->ctx, line->pin) == level;
+#else
+  return (*line->lev & line->mask) == (level ? line->mask : 0);
+#endif
+}
+
+static int run_inline(const struct gpio_line *line) {
+  int count = 0;
+  gpio_line_begin();
+  while (gpio_line_is(line, HIGH) && count < RUN) {
+    ++count;
+  }
+  gpio_line_end();
+  return count;
+}
+
+static int run_templated(const struct bcm2835_ctx *ctx,
+                         const struct DHT_pollers *poll) {
+  gpio_line_begin();
+  int count = poll->level_cycles(ctx, HIGH, RUN);
+  gpio_line_end();
+  return count;
+}
+
+enum variant { LEGACY, CTX, INLINE, TEMPLATED, VARIANTS };
+
+static const char *names[VARIANTS] = {
+  "bcm2835_gpio_lev", "bcm2835_ctx_gpio_lev", "gpio_line (inline)",
+  "levelCycles<pin>",
+};
+
+// Returns polls per microsecond
+static double measure(enum variant variant, const struct bcm2835_ctx *ctx,
+                      long polls) {
+  struct gpio_line line = gpio_line_open(ctx, BENCH_PIN);
+  const struct DHT_pollers *poll = DHT_pollers_for(BENCH_PIN);
+  long done = 0;
+  double start = now_s();
+  while (done < polls) {
+    switch (variant) {
+      case LEGACY:
+        done += run_legacy();
+        break;
+      case CTX:
+        done += run_ctx(ctx);
+        break;
+      case INLINE:
+        done += run_inline(&line);
+        break;
+      default:
+        done += run_templated(ctx, poll);
+        break;
+    }
+  }
+  return done / ((now_s() - start) * 1e6);
+}
+
+int main(int argc, char **argv) {
+  long polls = POLLS;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+      polls = atol(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [-n polls]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // The pin reads high throughout, so every run goes to RUN polls
+  registers[BCM2835_GPLEV0/4 + BENCH_PIN/32] = 1u << (BENCH_PIN % 32);
+  bcm2835_gpio = registers;
+  struct bcm2835_ctx ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.gpio = registers;
+
+  double rates[VARIANTS];
+  printf("%-22s %12s %10s %8s\n", "read", "polls/us", "ns/poll", "speedup");
+  for (int i = 0; i < VARIANTS; i++) {
+    measure(i, &ctx, polls / 10);
+    rates[i] = measure(i, &ctx, polls);
+    printf("%-22s %12.1f %10.2f %7.1fx\n", names[i], rates[i],
+           1e3 / rates[i], rates[i] / rates[LEGACY]);
+  }
+  return 0;
+}
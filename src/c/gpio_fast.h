@@ -0,0 +1,22 @@
+#ifndef GPIO_FAST
+#define GPIO_FAST
+
+// Ordering of the samples of a polling loop
+//
+// bcm2835_ctx_gpio_lev wraps every load in two full barriers. Reads of the
+// same peripheral stay in order without barriers between them (see
+// bcm2835_peri_read_nb), so the polling loops of capture_engine.hpp, which
+// load the pin's GPLEV register directly, only need gpio_line_begin before
+// a run of samples and gpio_line_end after it.
+
+// Orders the samples after any earlier access to another peripheral
+static inline void gpio_line_begin(void) {
+  __sync_synchronize();
+}
+
+// Orders the samples before any later access to another peripheral
+static inline void gpio_line_end(void) {
+  __sync_synchronize();
+}
+
+#endif
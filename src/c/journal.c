@@ -0,0 +1,239 @@
+#include "journal.h"
+
+#include "dht.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// CRC-32 (IEEE 802.3), table built once on first use
+static uint32_t crc_table[256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void build_crc_table(void) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    }
+    crc_table[i] = c;
+  }
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *buf, size_t len) {
+  pthread_once(&crc_table_once, build_crc_table);
+
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc = crc_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+// Checksum of a block; header crc field is treated as zero
+static uint32_t block_crc(const struct journal_block_header *header,
+                          const struct journal_record *records) {
+  struct journal_block_header copy = *header;
+  copy.crc = 0;
+  uint32_t crc = crc32_update(0, (const uint8_t *)&copy, sizeof(copy));
+  return crc32_update(crc, (const uint8_t *)records,
+                      header->count * sizeof(struct journal_record));
+}
+
+static int seconds_since(const struct timespec *then) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec - then->tv_sec;
+}
+
+uint64_t journal_scan(const uint8_t *data, size_t size,
+                      journal_cb cb, void *ctx,
+                      size_t *valid, uint32_t *blocks) {
+  uint64_t records = 0;
+  size_t offset = 0;
+  uint32_t seq = 0;
+
+  while (offset + sizeof(struct journal_block_header) <= size) {
+    struct journal_block_header header;
+    memcpy(&header, data + offset, sizeof(header));
+    size_t length = sizeof(header) + header.count * sizeof(struct journal_record);
+
+    // Stop at the first block that is torn, corrupt or out of sequence
+    if (header.magic != JOURNAL_MAGIC || header.seq != seq ||
+        header.count == 0 || header.count > JOURNAL_MAX_BATCH ||
+        offset + length > size) {
+      break;
+    }
+    const struct journal_record *block =
+      (const struct journal_record *)(data + offset + sizeof(header));
+    if (block_crc(&header, block) != header.crc) {
+      debug_print(stderr, "Checksum failed for journal block %u\n", seq);
+      break;
+    }
+
+    if (cb) {
+      for (uint16_t i = 0; i < header.count; i++) {
+        cb(ctx, &block[i]);
+      }
+    }
+    records += header.count;
+    offset += length;
+    seq++;
+  }
+
+  if (valid) {
+    *valid = offset;
+  }
+  if (blocks) {
+    *blocks = seq;
+  }
+  return records;
+}
+
+int journal_open(struct journal *journal, const char *path,
+                 unsigned int batch_records, unsigned int batch_seconds) {
+  if (!journal || !path) {
+    return ERROR_INVAL;
+  }
+  memset(journal, 0, sizeof(*journal));
+  journal->batch_records = batch_records ? batch_records : JOURNAL_BATCH_RECORDS;
+  if (journal->batch_records > JOURNAL_MAX_BATCH) {
+    journal->batch_records = JOURNAL_MAX_BATCH;
+  }
+  journal->batch_seconds = batch_seconds ? batch_seconds : JOURNAL_BATCH_SECONDS;
+  clock_gettime(CLOCK_MONOTONIC, &journal->last_commit);
+
+  journal->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (journal->fd < 0) {
+    debug_print(stderr, "Couldn't open journal %s\n", path);
+    return ERROR_DRIVER;
+  }
+
+  struct stat st;
+  if (fstat(journal->fd, &st)) {
+    goto fail;
+  }
+
+  // Find the valid prefix of an existing journal, and cut off a torn tail
+  if (st.st_size > 0) {
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, journal->fd, 0);
+    if (data == MAP_FAILED) {
+      goto fail;
+    }
+
+    size_t valid;
+    journal->records = journal_scan(data, st.st_size, NULL, NULL,
+                                    &valid, &journal->seq);
+    munmap(data, st.st_size);
+    journal->end = valid;
+
+    if (valid < (size_t)st.st_size) {
+      debug_print(stderr, "Truncating torn journal tail at %zu\n", valid);
+      if (ftruncate(journal->fd, valid) || fdatasync(journal->fd)) {
+        goto fail;
+      }
+    }
+  }
+
+  return NO_ERROR;
+
+fail:
+  close(journal->fd);
+  journal->fd = -1;
+  return ERROR_DRIVER;
+}
+
+int journal_commit(struct journal *journal) {
+  if (!journal || journal->fd < 0) {
+    return ERROR_INVAL;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &journal->last_commit);
+  if (!journal->npending) {
+    return NO_ERROR;
+  }
+
+  // Header and records go out in a single write, then one fdatasync
+  struct {
+    struct journal_block_header header;
+    struct journal_record records[JOURNAL_MAX_BATCH];
+  } block;
+  block.header.magic = JOURNAL_MAGIC;
+  block.header.seq = journal->seq;
+  block.header.count = journal->npending;
+  block.header.reserved = 0;
+  memcpy(block.records, journal->pending,
+         journal->npending * sizeof(struct journal_record));
+  block.header.crc = block_crc(&block.header, block.records);
+
+  size_t length = sizeof(block.header) +
+                  journal->npending * sizeof(struct journal_record);
+  if (pwrite(journal->fd, &block, length, journal->end) != (ssize_t)length ||
+      fdatasync(journal->fd)) {
+    debug_print(stderr, "%s\n", "Couldn't commit journal block");
+    return ERROR_DRIVER;
+  }
+
+  journal->end += length;
+  journal->seq++;
+  journal->records += journal->npending;
+  journal->npending = 0;
+  return NO_ERROR;
+}
+
+int journal_append(struct journal *journal, const struct journal_record *record) {
+  if (!journal || !record || journal->fd < 0) {
+    return ERROR_INVAL;
+  }
+
+  // A full batch is left over from a failed commit; retry it first
+  if (journal->npending == JOURNAL_MAX_BATCH) {
+    int err = journal_commit(journal);
+    if (err) {
+      return err;
+    }
+  }
+
+  journal->pending[journal->npending] = *record;
+  memset(journal->pending[journal->npending].reserved, 0,
+         sizeof(record->reserved));
+  journal->npending++;
+
+  if (journal->npending >= journal->batch_records ||
+      seconds_since(&journal->last_commit) >= (int)journal->batch_seconds) {
+    return journal_commit(journal);
+  }
+  return NO_ERROR;
+}
+
+int journal_close(struct journal *journal) {
+  if (!journal || journal->fd < 0) {
+    return ERROR_INVAL;
+  }
+  int err = journal_commit(journal);
+  close(journal->fd);
+  journal->fd = -1;
+  return err;
+}
+
+int64_t journal_replay(const struct journal *journal, journal_cb cb, void *ctx) {
+  if (!journal || journal->fd < 0) {
+    return -1;
+  }
+  if (!journal->end) {
+    return 0;
+  }
+
+  void *data = mmap(NULL, journal->end, PROT_READ, MAP_SHARED, journal->fd, 0);
+  if (data == MAP_FAILED) {
+    return -1;
+  }
+  madvise(data, journal->end, MADV_SEQUENTIAL);
+  uint64_t records = journal_scan(data, journal->end, cb, ctx, NULL, NULL);
+  munmap(data, journal->end);
+  return records;
+}
@@ -0,0 +1,82 @@
+#ifndef JOURNAL
+#define JOURNAL
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Append-only on-disk journal of readings
+//
+// The file is a sequence of blocks, each a header followed by up to
+// JOURNAL_MAX_BATCH fixed-size records. Pending records are kept in memory and
+// written as one block, followed by fdatasync, once batch_records have
+// accumulated or batch_seconds have passed since the last commit. The header
+// checksum covers the whole block, so a block torn by a crash or power loss
+// is detected and cut off the next time the journal is opened.
+
+#define JOURNAL_MAGIC 0x4A544844  // "DHTJ", little-endian
+#define JOURNAL_MAX_BATCH 256     // Max records per block
+
+// Defaults for group commit
+#define JOURNAL_BATCH_RECORDS 16
+#define JOURNAL_BATCH_SECONDS 300
+
+struct journal_record {
+  int64_t ts;             // Timestamp, seconds
+  int16_t temp;           // Temperature, tenths of deg C
+  int16_t hum;            // Humidity, tenths of %
+  uint8_t quality;
+  uint8_t reserved[3];
+};
+
+struct journal_block_header {
+  uint32_t magic;
+  uint32_t seq;           // Block sequence number, starting at 0
+  uint16_t count;         // Number of records following the header
+  uint16_t reserved;
+  uint32_t crc;           // CRC-32 of header (with crc = 0) and records
+};
+
+struct journal {
+  int fd;
+  uint64_t end;           // Offset just past the last valid block
+  uint32_t seq;           // Sequence number of next block
+  uint64_t records;       // Number of records committed to disk
+
+  // Group commit
+  unsigned int batch_records;
+  unsigned int batch_seconds;
+  struct timespec last_commit;
+  uint16_t npending;
+  struct journal_record pending[JOURNAL_MAX_BATCH];
+};
+
+// Called for each valid record found while scanning
+typedef void (*journal_cb)(void *ctx, const struct journal_record *record);
+
+// Open or create the journal at path, cutting off any torn tail
+// batch_records and batch_seconds of 0 select the defaults
+int journal_open(struct journal *journal, const char *path,
+                 unsigned int batch_records, unsigned int batch_seconds);
+
+// Queue a record, committing the batch if it is due
+int journal_append(struct journal *journal, const struct journal_record *record);
+
+// Write and fdatasync any pending records as one block
+int journal_commit(struct journal *journal);
+
+// Commit pending records and close the file
+int journal_close(struct journal *journal);
+
+// Walk the valid blocks of a journal image, calling cb for each record
+// Returns the number of records; if not NULL, *valid is set to the length of
+// the valid prefix and *blocks to the number of blocks in it
+uint64_t journal_scan(const uint8_t *data, size_t size,
+                      journal_cb cb, void *ctx,
+                      size_t *valid, uint32_t *blocks);
+
+// Map the committed part of an open journal and call cb for each record
+// Returns the number of records, or -1 on failure
+int64_t journal_replay(const struct journal *journal, journal_cb cb, void *ctx);
+
+#endif
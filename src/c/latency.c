@@ -0,0 +1,133 @@
+#include "latency.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static unsigned int bucket_of(uint64_t ns) {
+  if (ns < LATENCY_SUB_BUCKETS) {
+    return ns;
+  }
+  if (ns > LATENCY_MAX_NS) {
+    return LATENCY_BUCKETS - 1;
+  }
+
+  // Top LATENCY_SUB_BITS + 1 bits select the bucket within the power of two
+  unsigned int shift = 63 - __builtin_clzll(ns) - LATENCY_SUB_BITS;
+  return (shift + 1) * LATENCY_SUB_BUCKETS +
+         (unsigned int)(ns >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+// Largest value that falls in bucket
+static uint64_t bucket_top(unsigned int bucket) {
+  if (bucket < LATENCY_SUB_BUCKETS) {
+    return bucket;
+  }
+  unsigned int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+  uint64_t base = bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+  return ((base + 1) << shift) - 1;
+}
+
+void latency_record(struct latency_histogram *hist, uint64_t ns) {
+  if (!hist->count || ns < hist->min_ns) {
+    hist->min_ns = ns;
+  }
+  if (ns > hist->max_ns) {
+    hist->max_ns = ns;
+  }
+  hist->count++;
+  hist->sum_ns += ns;
+  hist->buckets[bucket_of(ns)]++;
+}
+
+uint64_t latency_percentile(const struct latency_histogram *hist,
+                            double fraction) {
+  if (!hist->count) {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)(fraction * hist->count + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += hist->buckets[i];
+    if (seen >= rank) {
+      // Never report beyond what was actually seen
+      uint64_t top = bucket_top(i);
+      return top < hist->max_ns ? top : hist->max_ns;
+    }
+  }
+  return hist->max_ns;
+}
+
+void latency_cumulative(const struct latency_histogram *hist,
+                        const uint64_t *bounds_ns, size_t n, uint64_t *out) {
+  uint64_t seen = 0;
+  size_t j = 0;
+  for (unsigned int i = 0; i < LATENCY_BUCKETS && j < n; i++) {
+    if (!hist->buckets[i]) {
+      continue;
+    }
+    uint64_t top = bucket_top(i);
+    while (j < n && top > bounds_ns[j]) {
+      out[j++] = seen;
+    }
+    seen += hist->buckets[i];
+  }
+  while (j < n) {
+    out[j++] = seen;
+  }
+}
+
+void latency_reset(struct latency_set *set) {
+  memset(set, 0, sizeof(*set));
+}
+
+const char *latency_phase_str(int phase) {
+  switch (phase) {
+    case LATENCY_INIT:
+      return "init";
+    case LATENCY_START:
+      return "start";
+    case LATENCY_RESPONSE:
+      return "response";
+    case LATENCY_BITS:
+      return "bits";
+    case LATENCY_DECODE:
+      return "decode";
+    case LATENCY_TOTAL:
+      return "total";
+    default:
+      return "unknown";
+  }
+}
+
+size_t latency_format(const struct latency_set *set, char *buf, size_t size) {
+  size_t length = 0;
+
+// Appends to buf while there is room, but always counts the full length
+#define APPEND(...) do { \
+    int n = snprintf(length < size ? buf + length : NULL, \
+                     length < size ? size - length : 0, __VA_ARGS__); \
+    length += n > 0 ? n : 0; \
+  } while (0)
+
+  APPEND("%-9s %8s %10s %10s %10s %10s %10s %10s %10s\n", "phase", "count",
+         "min", "mean", "p50", "p90", "p99", "p99.9", "max");
+  for (int i = 0; i < LATENCY_PHASES; i++) {
+    const struct latency_histogram *hist = &set->phases[i];
+    double mean = hist->count ? (double)hist->sum_ns / hist->count : 0;
+    APPEND("%-9s %8llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+           latency_phase_str(i), (unsigned long long)hist->count,
+           (hist->count ? hist->min_ns : 0) / 1e3, mean / 1e3,
+           latency_percentile(hist, 0.5) / 1e3,
+           latency_percentile(hist, 0.9) / 1e3,
+           latency_percentile(hist, 0.99) / 1e3,
+           latency_percentile(hist, 0.999) / 1e3,
+           hist->max_ns / 1e3);
+  }
+
+#undef APPEND
+  return length;
+}
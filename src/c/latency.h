@@ -0,0 +1,64 @@
+#ifndef LATENCY
+#define LATENCY
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Log-bucketed latency histograms for the phases of a read
+//
+// Values are nanoseconds. Each power of two is split into
+// LATENCY_SUB_BUCKETS linear buckets, so any recorded value is known to
+// within 1/16 (~6%) from 16 ns up to LATENCY_MAX_NS; smaller values are
+// exact and larger ones land in the last bucket. Recording is a few integer
+// operations on a fixed-size structure, and a zeroed histogram is empty, so
+// histograms can live in static storage without any set-up.
+
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BIT 35                       // 2^36 ns, about 68 s
+#define LATENCY_MAX_NS ((UINT64_C(1) << (LATENCY_MAX_BIT + 1)) - 1)
+#define LATENCY_BUCKETS ((LATENCY_MAX_BIT - LATENCY_SUB_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+enum latency_phase {
+  LATENCY_INIT,           // DHT_init: driver and pin set-up
+  LATENCY_START,          // Host start signal
+  LATENCY_RESPONSE,       // Waiting for the sensor to acknowledge
+  LATENCY_BITS,           // Capturing the 40 data bits
+  LATENCY_DECODE,         // Decoding bits and checking parity
+  LATENCY_TOTAL,          // Whole DHT_read_data call, retries included
+  LATENCY_PHASES,
+};
+
+struct latency_histogram {
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t min_ns;        // Only valid if count > 0
+  uint64_t max_ns;
+  uint32_t buckets[LATENCY_BUCKETS];
+};
+
+struct latency_set {
+  struct latency_histogram phases[LATENCY_PHASES];
+};
+
+void latency_record(struct latency_histogram *hist, uint64_t ns);
+
+// Smallest value v such that at least fraction (0-1) of the recorded values
+// are <= v, rounded up to the top of its bucket; 0 if empty
+uint64_t latency_percentile(const struct latency_histogram *hist,
+                            double fraction);
+
+// Sets out[i] to the number of values <= bounds_ns[i], counting a bucket
+// only if all of it is within the bound; bounds_ns must be ascending
+void latency_cumulative(const struct latency_histogram *hist,
+                        const uint64_t *bounds_ns, size_t n, uint64_t *out);
+
+void latency_reset(struct latency_set *set);
+
+const char *latency_phase_str(int phase);
+
+// Writes a table of counts and percentiles in microseconds, one row per
+// phase; returns the length of the full table, like snprintf
+size_t latency_format(const struct latency_set *set, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,85 @@
+#include "model.h"
+
+#include "dht.h"
+
+#include <stddef.h>
+#include <strings.h>
+
+// Humidity and temperature in tenths, 16 bits each, MSB first; the top bit
+// of the temperature is its sign, the rest its magnitude
+static void convert_tenths(const uint8_t *data,
+                           int16_t *humidity, int16_t *temperature) {
+  *humidity = (data[0] << 8) | data[1];
+  *temperature = ((data[2] & 0x7F) << 8) | data[3];
+  if (data[2] & 0x80) {
+    *temperature = -*temperature;
+  }
+}
+
+// Integral part then tenths of each; the DHT11 sets the top bit of the
+// temperature tenths below zero
+static void convert_decimal(const uint8_t *data,
+                            int16_t *humidity, int16_t *temperature) {
+  *humidity = data[0] * 10 + data[1];
+  *temperature = data[2] * 10 + (data[3] & 0x7F);
+  if (data[3] & 0x80) {
+    *temperature = -*temperature;
+  }
+}
+
+// No datasheet gives a wait before retrying; SENSOR_COOLDOWN_TIME_NS was
+// found by trial and error on the DHT22, and serves the others as well
+static const struct DHT_model_info models[DHT_MODELS] = {
+  [DHT_MODEL_DHT22] = {"DHT22", 800, 2000, SENSOR_COOLDOWN_TIME_NS, -400, 800, 1000,
+                       convert_tenths},
+  // Older parts stop at 0 to 50 deg C, later ones go down to -20
+  [DHT_MODEL_DHT11] = {"DHT11", 18000, 1000, SENSOR_COOLDOWN_TIME_NS, -200, 600, 1000,
+                       convert_decimal},
+  [DHT_MODEL_DHT21] = {"DHT21", 800, 2000, SENSOR_COOLDOWN_TIME_NS, -400, 800, 1000,
+                       convert_tenths},
+  [DHT_MODEL_AM2320] = {"AM2320", 800, 2000, SENSOR_COOLDOWN_TIME_NS, -400, 800, 1000,
+                        convert_tenths},
+};
+
+// Other names the same sensors are sold under
+static const struct {
+  const char *name;
+  int model;
+} aliases[] = {
+  {"AM2302", DHT_MODEL_DHT22},
+  {"AM2301", DHT_MODEL_DHT21},
+};
+
+const struct DHT_model_info *DHT_model_info(int model) {
+  if (model < 0 || model >= DHT_MODELS) {
+    return NULL;
+  }
+  return &models[model];
+}
+
+int DHT_model_convert(const struct DHT_model_info *model, const uint8_t *data,
+                      int16_t *humidity, int16_t *temperature) {
+  model->convert(data, humidity, temperature);
+  if (*temperature < model->temp_min || *temperature > model->temp_max ||
+      *humidity < 0 || *humidity > model->hum_max) {
+    return ERROR_PARITY;
+  }
+  return NO_ERROR;
+}
+
+int DHT_model_parse(const char *name) {
+  if (!name) {
+    return -1;
+  }
+  for (int i = 0; i < DHT_MODELS; i++) {
+    if (!strcasecmp(name, models[i].name)) {
+      return i;
+    }
+  }
+  for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); i++) {
+    if (!strcasecmp(name, aliases[i].name)) {
+      return aliases[i].model;
+    }
+  }
+  return -1;
+}
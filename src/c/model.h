@@ -0,0 +1,48 @@
+#ifndef MODEL
+#define MODEL
+
+#include <stdint.h>
+
+// Protocol differences between the single-wire sensors of the DHT family
+//
+// All of them answer the same start signal with the same 40-bit frame, and
+// the decoders compare each bit's high with its own low, so bit timing needs
+// no per-model thresholds. What differs is how long the start pulse must be,
+// how often the sensor can be read, how the bytes encode the values, and
+// what range they can take.
+
+enum DHT_model {
+  DHT_MODEL_DHT22,         // Also sold as AM2302; the default
+  DHT_MODEL_DHT11,
+  DHT_MODEL_DHT21,         // Also sold as AM2301
+  DHT_MODEL_AM2320,        // In single-wire mode, SDA as data
+  DHT_MODELS,
+};
+
+struct DHT_model_info {
+  const char *name;
+  int start_low_us;        // Shortest start pulse the datasheet allows
+  int min_interval_ms;     // Shortest time between reads
+  long cooldown_ns;        // Wait before retrying a failed attempt
+  int16_t temp_min;        // Measuring range, tenths of deg C
+  int16_t temp_max;
+  int16_t hum_max;         // Tenths of %, from 0
+
+  // Converts the five bytes of a frame to tenths of % and of deg C
+  void (*convert)(const uint8_t *data, int16_t *humidity, int16_t *temperature);
+};
+
+// Properties of model, or NULL if it isn't an enum DHT_model
+const struct DHT_model_info *DHT_model_info(int model);
+
+// Converts a frame whose checksum matched as model encodes it; returns
+// ERROR_PARITY if the values are out of the model's range, as a frame with
+// two bits flipped in the same column still sums right
+int DHT_model_convert(const struct DHT_model_info *model, const uint8_t *data,
+                      int16_t *humidity, int16_t *temperature);
+
+// enum DHT_model named name, e.g. "DHT22" or "AM2302", ignoring case;
+// -1 if unknown
+int DHT_model_parse(const char *name);
+
+#endif
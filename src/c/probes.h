@@ -0,0 +1,64 @@
+#ifndef PROBES
+#define PROBES
+
+// USDT (SystemTap/DTrace-style) static probes, provider "dht"
+//
+// With <sys/sdt.h> available (systemtap-sdt-dev), each probe compiles to a
+// single nop plus a note describing its arguments; perf, bpftrace and
+// SystemTap patch the nop only while attached. Without the header, or with
+// -DDHT_NO_PROBES, probes compile to nothing. See dht-latency.bt.
+//
+// Probes that would otherwise land between two sampled edges fire after the
+// capture instead, since a uprobe hit costs microseconds while attached.
+// Arguments that take work to gather are only gathered while a tracer is
+// attached: check DHT_PROBE_ENABLED(name) first, as for bit.
+//
+//   start_signal(pin)                        Host starts the start signal
+//   ack_low(pin, cycles, ns)                 After capture: response low,
+//                                            and ns from the start signal
+//                                            to its end; not fired if it
+//                                            timed out
+//   ack_high(pin, cycles)                    After capture: response high
+//   bit(pin, index, low_cycles, high_cycles) After capture: once per bit
+//   frame_done(pin, attempt, hum, temp)      Frame decoded; raw sensor values
+//   parity_fail(pin, attempt, received, computed)
+//   range_fail(pin, attempt, hum, temp)      Checksum matched, but values, in
+//                                            tenths, out of the model's range
+//   retry(pin, attempt, stage)               Attempt failed; enum DHT_stage
+
+#if defined(__has_include) && !defined(DHT_NO_PROBES)
+#if __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define DHT_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef DHT_HAVE_PROBES
+// With _SDT_HAS_SEMAPHORES, every probe's note points at a dht_<name>_semaphore
+// that tracers increment while attached; DHT_PROBE_SEMAPHORES defines them
+// and goes once at file scope in the file firing the probes
+#define DHT_SEMAPHORE(name) \
+  __extension__ unsigned short dht_##name##_semaphore \
+  __attribute__((used, section(".probes")))
+#define DHT_PROBE_SEMAPHORES \
+  DHT_SEMAPHORE(start_signal); DHT_SEMAPHORE(ack_low); \
+  DHT_SEMAPHORE(ack_high); DHT_SEMAPHORE(bit); DHT_SEMAPHORE(frame_done); \
+  DHT_SEMAPHORE(parity_fail); DHT_SEMAPHORE(range_fail); DHT_SEMAPHORE(retry);
+#define DHT_PROBE_ENABLED(name) __builtin_expect(dht_##name##_semaphore, 0)
+
+#define DHT_PROBE1(name, a) DTRACE_PROBE1(dht, name, a)
+#define DHT_PROBE2(name, a, b) DTRACE_PROBE2(dht, name, a, b)
+#define DHT_PROBE3(name, a, b, c) DTRACE_PROBE3(dht, name, a, b, c)
+#define DHT_PROBE4(name, a, b, c, d) DTRACE_PROBE4(dht, name, a, b, c, d)
+#else
+#define DHT_PROBE_SEMAPHORES
+#define DHT_PROBE_ENABLED(name) 0
+
+#define DHT_PROBE1(name, a) do { } while (0)
+#define DHT_PROBE2(name, a, b) do { } while (0)
+#define DHT_PROBE3(name, a, b, c) do { } while (0)
+#define DHT_PROBE4(name, a, b, c, d) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,272 @@
+#include "ring.h"
+
+#include "dht.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Worst-case encoded size of one reading:
+// 36 bits of timestamp, 19 bits each of temperature/humidity, 9 of quality
+#define RING_MAX_READING_BITS 83
+
+// Write the n low bits of value into buf at bit position *pos, MSB first
+static void put_bits(uint8_t *buf, uint16_t *pos, uint32_t value, int n) {
+  for (int i = n - 1; i >= 0; i--) {
+    if (value & (1u << i)) {
+      buf[*pos / 8] |= 0x80 >> (*pos % 8);
+    }
+    ++*pos;
+  }
+}
+
+// Read n bits from buf at bit position *pos, MSB first
+static uint32_t get_bits(const uint8_t *buf, uint16_t *pos, int n) {
+  uint32_t value = 0;
+  for (int i = 0; i < n; i++) {
+    value = (value << 1) | ((buf[*pos / 8] >> (7 - *pos % 8)) & 1);
+    ++*pos;
+  }
+  return value;
+}
+
+// Sign-extend the n-bit two's complement value
+static int32_t sign_extend(uint32_t value, int n) {
+  uint32_t sign = 1u << (n - 1);
+  return (int32_t)((value ^ sign) - sign);
+}
+
+// Number of leading 1s in a prefix code, reading at most max bits
+static int get_prefix(const uint8_t *buf, uint16_t *pos, int max) {
+  int ones = 0;
+  while (ones < max && get_bits(buf, pos, 1)) {
+    ++ones;
+  }
+  return ones;
+}
+
+// Timestamp delta-of-delta:
+// '0' for no change, then '10', '110', '1110' with 7/9/12 signed bits,
+// and '1111' followed by 32 signed bits
+static void put_dod(uint8_t *buf, uint16_t *pos, int32_t dod) {
+  if (dod == 0) {
+    put_bits(buf, pos, 0x0, 1);
+  } else if (dod >= -64 && dod < 64) {
+    put_bits(buf, pos, 0x2, 2);
+    put_bits(buf, pos, (uint32_t)dod & 0x7F, 7);
+  } else if (dod >= -256 && dod < 256) {
+    put_bits(buf, pos, 0x6, 3);
+    put_bits(buf, pos, (uint32_t)dod & 0x1FF, 9);
+  } else if (dod >= -2048 && dod < 2048) {
+    put_bits(buf, pos, 0xE, 4);
+    put_bits(buf, pos, (uint32_t)dod & 0xFFF, 12);
+  } else {
+    put_bits(buf, pos, 0xF, 4);
+    put_bits(buf, pos, (uint32_t)dod, 32);
+  }
+}
+
+static int32_t get_dod(const uint8_t *buf, uint16_t *pos) {
+  switch (get_prefix(buf, pos, 4)) {
+    case 0: return 0;
+    case 1: return sign_extend(get_bits(buf, pos, 7), 7);
+    case 2: return sign_extend(get_bits(buf, pos, 9), 9);
+    case 3: return sign_extend(get_bits(buf, pos, 12), 12);
+    default: return (int32_t)get_bits(buf, pos, 32);
+  }
+}
+
+// Value in tenths:
+// '0' for no change, '10' and '110' with a 5/9 bit signed delta,
+// and '111' followed by the raw 16-bit value
+static void put_value(uint8_t *buf, uint16_t *pos, int16_t prev, int16_t value) {
+  int32_t delta = (int32_t)value - prev;
+  if (delta == 0) {
+    put_bits(buf, pos, 0x0, 1);
+  } else if (delta >= -16 && delta < 16) {
+    put_bits(buf, pos, 0x2, 2);
+    put_bits(buf, pos, (uint32_t)delta & 0x1F, 5);
+  } else if (delta >= -256 && delta < 256) {
+    put_bits(buf, pos, 0x6, 3);
+    put_bits(buf, pos, (uint32_t)delta & 0x1FF, 9);
+  } else {
+    put_bits(buf, pos, 0x7, 3);
+    put_bits(buf, pos, (uint16_t)value, 16);
+  }
+}
+
+static int16_t get_value(const uint8_t *buf, uint16_t *pos, int16_t prev) {
+  switch (get_prefix(buf, pos, 3)) {
+    case 0: return prev;
+    case 1: return prev + sign_extend(get_bits(buf, pos, 5), 5);
+    case 2: return prev + sign_extend(get_bits(buf, pos, 9), 9);
+    default: return (int16_t)get_bits(buf, pos, 16);
+  }
+}
+
+// Quality: '0' for no change, otherwise '1' followed by 8 bits
+static void put_quality(uint8_t *buf, uint16_t *pos, uint8_t prev, uint8_t quality) {
+  if (quality == prev) {
+    put_bits(buf, pos, 0x0, 1);
+  } else {
+    put_bits(buf, pos, 0x1, 1);
+    put_bits(buf, pos, quality, 8);
+  }
+}
+
+static uint8_t get_quality(const uint8_t *buf, uint16_t *pos, uint8_t prev) {
+  return get_bits(buf, pos, 1) ? (uint8_t)get_bits(buf, pos, 8) : prev;
+}
+
+// Start a new head block holding the reading uncompressed,
+// evicting the oldest block if the ring is full
+static void start_block(struct ring *ring, int64_t ts,
+                        int16_t temp, int16_t hum, uint8_t quality) {
+  if (ring->used) {
+    ring->head = (ring->head + 1) % ring->capacity;
+  }
+  if (ring->used == ring->capacity) {
+    ring->count -= ring->blocks[ring->head].count;
+  } else {
+    ring->used++;
+  }
+
+  struct ring_block *block = &ring->blocks[ring->head];
+  memset(block, 0, sizeof(*block));
+  block->first_ts = ts;
+  block->last_ts = ts;
+  block->first_temp = temp;
+  block->first_hum = hum;
+  block->first_quality = quality;
+  block->count = 1;
+  ring->count++;
+
+  ring->prev_ts = ts;
+  ring->prev_delta = 0;
+}
+
+struct ring *ring_create(size_t max_bytes) {
+  size_t capacity = max_bytes / sizeof(struct ring_block);
+  if (capacity < RING_MIN_BLOCKS) {
+    return NULL;
+  }
+
+  struct ring *ring = calloc(1, sizeof(*ring));
+  if (!ring) {
+    return NULL;
+  }
+  ring->blocks = calloc(capacity, sizeof(struct ring_block));
+  if (!ring->blocks) {
+    free(ring);
+    return NULL;
+  }
+  ring->capacity = capacity;
+  return ring;
+}
+
+void ring_destroy(struct ring *ring) {
+  if (!ring) {
+    return;
+  }
+  free(ring->blocks);
+  free(ring);
+}
+
+int ring_append(struct ring *ring, int64_t ts,
+                int16_t temp, int16_t hum, uint8_t quality) {
+  if (!ring) {
+    return ERROR_INVAL;
+  }
+  if (ring->used && ts < ring->prev_ts) {
+    debug_print(stderr, "%s\n", "Reading is older than head of ring");
+    return ERROR_INVAL;
+  }
+
+  struct ring_block *block = &ring->blocks[ring->head];
+  int64_t delta = ts - ring->prev_ts;
+  int64_t dod = delta - ring->prev_delta;
+
+  // Start a new block if this is the first reading, the block is full,
+  // or the timestamp jump does not fit in the widest code
+  if (!ring->used ||
+      block->count == UINT16_MAX ||
+      block->nbits + RING_MAX_READING_BITS > RING_BLOCK_BYTES * 8 ||
+      dod < INT32_MIN || dod > INT32_MAX) {
+    start_block(ring, ts, temp, hum, quality);
+  } else {
+    put_dod(block->bits, &block->nbits, (int32_t)dod);
+    put_value(block->bits, &block->nbits, ring->prev_temp, temp);
+    put_value(block->bits, &block->nbits, ring->prev_hum, hum);
+    put_quality(block->bits, &block->nbits, ring->prev_quality, quality);
+    block->last_ts = ts;
+    block->count++;
+    ring->count++;
+    ring->prev_ts = ts;
+    ring->prev_delta = delta;
+  }
+
+  ring->prev_temp = temp;
+  ring->prev_hum = hum;
+  ring->prev_quality = quality;
+  return NO_ERROR;
+}
+
+// Index of the i-th oldest block
+static size_t block_index(const struct ring *ring, size_t i) {
+  return (ring->head + ring->capacity - ring->used + 1 + i) % ring->capacity;
+}
+
+size_t ring_count_range(const struct ring *ring, int64_t from, int64_t to) {
+  size_t count = 0;
+  for (size_t i = 0; ring && i < ring->used; i++) {
+    const struct ring_block *block = &ring->blocks[block_index(ring, i)];
+    if (block->last_ts >= from && block->first_ts <= to) {
+      count += block->count;
+    }
+  }
+  return count;
+}
+
+size_t ring_query(const struct ring *ring, int64_t from, int64_t to,
+                  double *out, size_t max_readings) {
+  size_t n = 0;
+  for (size_t i = 0; ring && i < ring->used && n < max_readings; i++) {
+    const struct ring_block *block = &ring->blocks[block_index(ring, i)];
+    if (block->last_ts < from || block->first_ts > to) {
+      continue;
+    }
+
+    int64_t ts = block->first_ts;
+    int64_t delta = 0;
+    int16_t temp = block->first_temp;
+    int16_t hum = block->first_hum;
+    uint8_t quality = block->first_quality;
+    uint16_t pos = 0;
+
+    for (uint16_t j = 0; j < block->count && n < max_readings; j++) {
+      if (j) {
+        delta += get_dod(block->bits, &pos);
+        ts += delta;
+        temp = get_value(block->bits, &pos, temp);
+        hum = get_value(block->bits, &pos, hum);
+        quality = get_quality(block->bits, &pos, quality);
+      }
+      if (ts > to) {
+        break;
+      }
+      if (ts >= from) {
+        double *reading = out + n * RING_VALUES_PER_READING;
+        reading[0] = (double)ts;
+        reading[1] = temp / 10.0;
+        reading[2] = hum / 10.0;
+        reading[3] = quality;
+        n++;
+      }
+    }
+  }
+  return n;
+}
+
+size_t ring_memory(const struct ring *ring) {
+  return ring ? ring->capacity * sizeof(struct ring_block) : 0;
+}
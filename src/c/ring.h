@@ -0,0 +1,68 @@
+#ifndef RING
+#define RING
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressed, fixed-memory ring of sensor readings
+//
+// Readings are packed into fixed-size blocks. The first reading of a block is
+// stored verbatim in the block header; every following reading is encoded as
+// a delta-of-delta timestamp and deltas of the temperature/humidity tenths,
+// using short variable-length bit codes. Steady one-minute data costs about
+// 1-2 bytes per reading. When the ring is full, the oldest block is dropped.
+
+#define RING_BLOCK_BYTES 240       // Size of the bit stream in each block
+#define RING_MIN_BLOCKS 2          // Smallest ring that can be created
+#define RING_VALUES_PER_READING 4  // Doubles per reading written by ring_query
+
+// Block of compressed readings; first reading is kept uncompressed
+struct ring_block {
+  int64_t first_ts;       // Timestamp of first reading, seconds
+  int64_t last_ts;        // Timestamp of last reading, seconds
+  int16_t first_temp;     // Temperature of first reading, tenths of deg C
+  int16_t first_hum;      // Humidity of first reading, tenths of %
+  uint8_t first_quality;  // Quality of first reading
+  uint16_t count;         // Number of readings in block
+  uint16_t nbits;         // Number of bits used in bits[]
+  uint8_t bits[RING_BLOCK_BYTES];
+};
+
+struct ring {
+  struct ring_block *blocks;
+  size_t capacity;        // Number of blocks
+  size_t head;            // Block currently being appended to
+  size_t used;            // Number of blocks holding data
+  size_t count;           // Total number of readings held
+
+  // Encoder state for the head block
+  int64_t prev_ts;
+  int64_t prev_delta;
+  int16_t prev_temp;
+  int16_t prev_hum;
+  uint8_t prev_quality;
+};
+
+// Allocate a ring using at most max_bytes of memory for blocks
+// Returns NULL if max_bytes is too small or allocation fails
+struct ring *ring_create(size_t max_bytes);
+void ring_destroy(struct ring *ring);
+
+// Append a reading; timestamps must not go backwards
+// temp and hum are in tenths of a unit, as transmitted by the sensor
+int ring_append(struct ring *ring, int64_t ts,
+                int16_t temp, int16_t hum, uint8_t quality);
+
+// Upper bound on the number of readings with from <= ts <= to
+size_t ring_count_range(const struct ring *ring, int64_t from, int64_t to);
+
+// Decode readings with from <= ts <= to, oldest first, into out as
+// RING_VALUES_PER_READING doubles each: timestamp, deg C, %, quality
+// Writes at most max_readings; returns number of readings written
+size_t ring_query(const struct ring *ring, int64_t from, int64_t to,
+                  double *out, size_t max_readings);
+
+// Number of bytes of block memory held by the ring
+size_t ring_memory(const struct ring *ring);
+
+#endif
@@ -0,0 +1,108 @@
+#include "rollup.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Benchmark for the rollup engine: ingest one million one-minute readings,
+// then compare aggregate queries against a scan over the raw readings
+
+#define NUM_READINGS 1000000
+#define START_TS 1577836800  // 2020-01-01
+#define QUERY_REPEATS 1000
+
+struct raw_reading {
+  int64_t ts;
+  int16_t temp;
+  int16_t hum;
+};
+
+static double now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Naive mean temperature over [from, to] from raw readings
+static double raw_mean(const struct raw_reading *raw, size_t n,
+                       int64_t from, int64_t to) {
+  int64_t sum = 0;
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (raw[i].ts >= from && raw[i].ts <= to) {
+      sum += raw[i].temp;
+      count++;
+    }
+  }
+  return count ? sum / 10.0 / count : 0;
+}
+
+static void bench_query(const struct rollup *rollup, const struct raw_reading *raw,
+                        enum rollup_resolution res, const char *name,
+                        int64_t from, int64_t to) {
+  struct rollup_aggregate agg;
+  volatile double sink = 0;
+
+  double start = now_ns();
+  for (int i = 0; i < QUERY_REPEATS; i++) {
+    rollup_aggregate(rollup, res, from, to, &agg);
+    sink += agg.temp_mean;
+  }
+  double rollup_ns = (now_ns() - start) / QUERY_REPEATS;
+
+  start = now_ns();
+  for (int i = 0; i < QUERY_REPEATS / 100; i++) {
+    sink += raw_mean(raw, NUM_READINGS, from, to);
+  }
+  double raw_ns = (now_ns() - start) / (QUERY_REPEATS / 100);
+
+  printf("%-22s rollup %10.0f ns (%u readings, mean %.2f)   raw scan %12.0f ns (mean %.2f)\n",
+         name, rollup_ns, agg.count, agg.temp_mean, raw_ns,
+         raw_mean(raw, NUM_READINGS, from, to));
+}
+
+int main(void) {
+  struct raw_reading *raw = malloc(NUM_READINGS * sizeof(*raw));
+  if (!raw) {
+    return 1;
+  }
+
+  // Slowly drifting synthetic readings, one per minute
+  srand(1);
+  int temp = 215, hum = 450;
+  for (size_t i = 0; i < NUM_READINGS; i++) {
+    temp += rand() % 3 - 1;
+    hum += rand() % 3 - 1;
+    if (hum < 0) hum = 0;
+    if (hum > 1000) hum = 1000;
+    raw[i].ts = START_TS + (int64_t)i * 60;
+    raw[i].temp = temp;
+    raw[i].hum = hum;
+  }
+
+  struct rollup rollup;
+  if (rollup_init(&rollup, NULL)) {
+    return 1;
+  }
+
+  double start = now_ns();
+  for (size_t i = 0; i < NUM_READINGS; i++) {
+    rollup_add(&rollup, raw[i].ts, raw[i].temp, raw[i].hum);
+  }
+  double elapsed = now_ns() - start;
+  printf("Ingested %d readings in %.1f ms (%.1f ns/reading)\n",
+         NUM_READINGS, elapsed / 1e6, elapsed / NUM_READINGS);
+
+  int64_t last = raw[NUM_READINGS - 1].ts;
+  bench_query(&rollup, raw, ROLLUP_MINUTE, "Last hour (minutes)", last - 3600 + 1, last);
+  bench_query(&rollup, raw, ROLLUP_HOUR, "Last day (hours)",
+              last - last % 3600 - 23 * 3600, last);
+  bench_query(&rollup, raw, ROLLUP_HOUR, "Last 30 days (hours)",
+              last - last % 3600 - 719 * 3600, last);
+  bench_query(&rollup, raw, ROLLUP_DAY, "Last year (days)",
+              last - last % 86400 - 365 * 86400, last);
+
+  rollup_free(&rollup);
+  free(raw);
+  return 0;
+}
@@ -0,0 +1,187 @@
+#include "rollup.h"
+
+#include "dht.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static const int64_t resolution_seconds[ROLLUP_NUM_RESOLUTIONS] = {
+  60, 60 * 60, 24 * 60 * 60
+};
+
+static const size_t default_retention[ROLLUP_NUM_RESOLUTIONS] = {
+  ROLLUP_MINUTES, ROLLUP_HOURS, ROLLUP_DAYS
+};
+
+static struct rollup_bucket *slot(const struct rollup_level *level, int64_t start) {
+  return &level->buckets[(size_t)(start / level->seconds) % level->nbuckets];
+}
+
+// Start of the oldest bucket still retained
+static int64_t oldest(const struct rollup_level *level) {
+  return level->latest - (int64_t)(level->nbuckets - 1) * level->seconds;
+}
+
+int rollup_init(struct rollup *rollup, const size_t *retention) {
+  if (!rollup) {
+    return ERROR_INVAL;
+  }
+
+  // Nothing allocated yet, so rollup_free is safe whatever happens below
+  for (int i = 0; i < ROLLUP_NUM_RESOLUTIONS; i++) {
+    rollup->levels[i].buckets = NULL;
+    rollup->levels[i].nbuckets = 0;
+    rollup->levels[i].latest = -1;
+  }
+
+  for (int i = 0; i < ROLLUP_NUM_RESOLUTIONS; i++) {
+    struct rollup_level *level = &rollup->levels[i];
+    level->seconds = resolution_seconds[i];
+    level->nbuckets = retention && retention[i] ? retention[i] : default_retention[i];
+    level->latest = -1;
+    if (level->nbuckets > ROLLUP_MAX_BUCKETS) {
+      rollup_free(rollup);
+      return ERROR_INVAL;
+    }
+    level->buckets = malloc(level->nbuckets * sizeof(struct rollup_bucket));
+    if (!level->buckets) {
+      rollup_free(rollup);
+      return ERROR_INVAL;
+    }
+    for (size_t j = 0; j < level->nbuckets; j++) {
+      level->buckets[j].start = -1;
+    }
+  }
+  return NO_ERROR;
+}
+
+void rollup_free(struct rollup *rollup) {
+  for (int i = 0; rollup && i < ROLLUP_NUM_RESOLUTIONS; i++) {
+    free(rollup->levels[i].buckets);
+    rollup->levels[i].buckets = NULL;
+    rollup->levels[i].nbuckets = 0;
+  }
+}
+
+void rollup_add(struct rollup *rollup, int64_t ts, int16_t temp, int16_t hum) {
+  if (!rollup || ts < 0) {
+    return;
+  }
+
+  for (int i = 0; i < ROLLUP_NUM_RESOLUTIONS; i++) {
+    struct rollup_level *level = &rollup->levels[i];
+    if (!level->nbuckets) {
+      continue;             // Failed or freed
+    }
+    int64_t start = ts - ts % level->seconds;
+
+    if (start > level->latest) {
+      level->latest = start;
+    } else if (start < oldest(level)) {
+      continue;
+    }
+
+    // A slot still holding an older bucket is reused; one already holding
+    // a newer bucket means this reading has fallen out of the window
+    struct rollup_bucket *bucket = slot(level, start);
+    if (bucket->start > start) {
+      continue;
+    }
+    if (bucket->start < start) {
+      bucket->start = start;
+      bucket->count = 0;
+      bucket->temp_min = bucket->temp_max = temp;
+      bucket->hum_min = bucket->hum_max = hum;
+      bucket->temp_sum = bucket->hum_sum = 0;
+    }
+
+    bucket->count++;
+    bucket->temp_sum += temp;
+    bucket->hum_sum += hum;
+    if (temp < bucket->temp_min) bucket->temp_min = temp;
+    if (temp > bucket->temp_max) bucket->temp_max = temp;
+    if (hum < bucket->hum_min) bucket->hum_min = hum;
+    if (hum > bucket->hum_max) bucket->hum_max = hum;
+  }
+}
+
+// Start of the first retained bucket beginning at or after from
+static int64_t first_start(const struct rollup_level *level, int64_t from) {
+  int64_t start = oldest(level);
+  if (from > start) {
+    start = from + (level->seconds - from % level->seconds) % level->seconds;
+  }
+  return start < 0 ? 0 : start;
+}
+
+int rollup_aggregate(const struct rollup *rollup, enum rollup_resolution res,
+                     int64_t from, int64_t to, struct rollup_aggregate *out) {
+  if (!rollup || !out || res >= ROLLUP_NUM_RESOLUTIONS) {
+    return ERROR_INVAL;
+  }
+
+  const struct rollup_level *level = &rollup->levels[res];
+  uint32_t count = 0;
+  int64_t temp_sum = 0, hum_sum = 0;
+  int16_t temp_min = INT16_MAX, temp_max = INT16_MIN;
+  int16_t hum_min = INT16_MAX, hum_max = INT16_MIN;
+
+  for (int64_t start = first_start(level, from);
+       start <= to && start <= level->latest; start += level->seconds) {
+    const struct rollup_bucket *bucket = slot(level, start);
+    if (bucket->start != start) {
+      continue;
+    }
+    count += bucket->count;
+    temp_sum += bucket->temp_sum;
+    hum_sum += bucket->hum_sum;
+    if (bucket->temp_min < temp_min) temp_min = bucket->temp_min;
+    if (bucket->temp_max > temp_max) temp_max = bucket->temp_max;
+    if (bucket->hum_min < hum_min) hum_min = bucket->hum_min;
+    if (bucket->hum_max > hum_max) hum_max = bucket->hum_max;
+  }
+
+  out->count = count;
+  if (!count) {
+    out->temp_min = out->temp_max = out->temp_mean = 0;
+    out->hum_min = out->hum_max = out->hum_mean = 0;
+    return NO_ERROR;
+  }
+  out->temp_min = temp_min / 10.0;
+  out->temp_max = temp_max / 10.0;
+  out->temp_mean = temp_sum / 10.0 / count;
+  out->hum_min = hum_min / 10.0;
+  out->hum_max = hum_max / 10.0;
+  out->hum_mean = hum_sum / 10.0 / count;
+  return NO_ERROR;
+}
+
+size_t rollup_series(const struct rollup *rollup, enum rollup_resolution res,
+                     int64_t from, int64_t to, double *out, size_t max_buckets) {
+  if (!rollup || !out || res >= ROLLUP_NUM_RESOLUTIONS) {
+    return 0;
+  }
+
+  const struct rollup_level *level = &rollup->levels[res];
+  size_t n = 0;
+
+  for (int64_t start = first_start(level, from);
+       start <= to && start <= level->latest && n < max_buckets;
+       start += level->seconds) {
+    const struct rollup_bucket *bucket = slot(level, start);
+    if (bucket->start != start) {
+      continue;
+    }
+    double *values = out + n * ROLLUP_VALUES_PER_BUCKET;
+    values[0] = (double)bucket->start;
+    values[1] = bucket->count;
+    values[2] = bucket->temp_min / 10.0;
+    values[3] = bucket->temp_max / 10.0;
+    values[4] = bucket->temp_sum / 10.0 / bucket->count;
+    values[5] = bucket->hum_min / 10.0;
+    values[6] = bucket->hum_max / 10.0;
+    values[7] = bucket->hum_sum / 10.0 / bucket->count;
+    n++;
+  }
+  return n;
+}
@@ -0,0 +1,79 @@
+#ifndef ROLLUP
+#define ROLLUP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental min/max/mean rollups of readings
+//
+// Each resolution keeps a ring of buckets indexed by (start / seconds) modulo
+// the number of buckets retained, so adding a reading is O(1) and an
+// aggregate over a time range touches only the buckets in that range.
+
+enum rollup_resolution {
+  ROLLUP_MINUTE,
+  ROLLUP_HOUR,
+  ROLLUP_DAY,
+  ROLLUP_NUM_RESOLUTIONS,
+};
+
+// Default number of buckets retained at each resolution
+#define ROLLUP_MINUTES 1440  // One day
+#define ROLLUP_HOURS 720     // 30 days
+#define ROLLUP_DAYS 366      // One year
+#define ROLLUP_MAX_BUCKETS (1 << 20)  // Per resolution, about two years of minutes
+
+#define ROLLUP_VALUES_PER_BUCKET 8  // Doubles per bucket written by rollup_series
+
+struct rollup_bucket {
+  int64_t start;          // Start of bucket, seconds; -1 if empty
+  uint32_t count;
+  int16_t temp_min;       // Temperature/humidity in tenths, as from the sensor
+  int16_t temp_max;
+  int16_t hum_min;
+  int16_t hum_max;
+  int64_t temp_sum;
+  int64_t hum_sum;
+};
+
+struct rollup_level {
+  int64_t seconds;        // Width of each bucket
+  size_t nbuckets;
+  int64_t latest;         // Start of newest bucket, -1 if none
+  struct rollup_bucket *buckets;
+};
+
+struct rollup {
+  struct rollup_level levels[ROLLUP_NUM_RESOLUTIONS];
+};
+
+// Aggregate over a range of buckets; means are in deg C and %
+struct rollup_aggregate {
+  uint32_t count;
+  double temp_min, temp_max, temp_mean;
+  double hum_min, hum_max, hum_mean;
+};
+
+// Allocate buckets; retention holds the number of buckets per resolution,
+// where 0 selects the default. retention may be NULL.
+// Returns ERROR_INVAL if a retention exceeds ROLLUP_MAX_BUCKETS or the
+// buckets can't be allocated; the rollup then holds nothing, and
+// rollup_free on it is harmless.
+int rollup_init(struct rollup *rollup, const size_t *retention);
+void rollup_free(struct rollup *rollup);
+
+// Add a reading to every resolution
+// Readings older than a resolution's retention window are ignored there
+void rollup_add(struct rollup *rollup, int64_t ts, int16_t temp, int16_t hum);
+
+// Combine the buckets of a resolution starting within [from, to]
+int rollup_aggregate(const struct rollup *rollup, enum rollup_resolution res,
+                     int64_t from, int64_t to, struct rollup_aggregate *out);
+
+// Write each non-empty bucket starting within [from, to], oldest first, as
+// ROLLUP_VALUES_PER_BUCKET doubles: start, count, temperature min/max/mean,
+// humidity min/max/mean. Returns the number of buckets written.
+size_t rollup_series(const struct rollup *rollup, enum rollup_resolution res,
+                     int64_t from, int64_t to, double *out, size_t max_buckets);
+
+#endif
@@ -0,0 +1,125 @@
+#include "stats.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static void counter_add(uint64_t *counter, uint64_t value) {
+  __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static uint64_t counter_load(const uint64_t *counter) {
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+uint64_t stats_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+struct stats_file *stats_open(const char *path, int writable) {
+  int fd = open(path, writable ? O_RDWR | O_CREAT | O_CLOEXEC
+                               : O_RDONLY | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    debug_print(stderr, "Couldn't open stats file %s\n", path);
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) ||
+      (st.st_size < (off_t)sizeof(struct stats_file) &&
+       (!writable || st.st_size || ftruncate(fd, sizeof(struct stats_file))))) {
+    close(fd);
+    return NULL;
+  }
+
+  struct stats_file *stats = mmap(NULL, sizeof(*stats),
+                                  writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                                  MAP_SHARED, fd, 0);
+  close(fd);
+  if (stats == MAP_FAILED) {
+    return NULL;
+  }
+
+  // A new file is all zeroes; claim it, unless another writer got there first
+  uint32_t unset = 0;
+  if (writable && !__atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE)) {
+    stats->version = STATS_VERSION;
+    stats->npins = NUM_PINS;
+    __atomic_compare_exchange_n(&stats->magic, &unset, STATS_MAGIC, 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+  }
+  if (__atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC ||
+      stats->version != STATS_VERSION || stats->npins != NUM_PINS) {
+    debug_print(stderr, "%s is not a stats file\n", path);
+    munmap(stats, sizeof(*stats));
+    return NULL;
+  }
+  return stats;
+}
+
+void stats_close(struct stats_file *stats) {
+  if (stats) {
+    munmap(stats, sizeof(*stats));
+  }
+}
+
+void stats_count_read(struct stats_file *stats, int pin) {
+  counter_add(&stats->pins[pin].reads, 1);
+}
+
+void stats_count_attempt(struct stats_file *stats, int pin, int stage,
+                         uint64_t busy_ns, int retrying) {
+  struct stats_pin *counters = &stats->pins[pin];
+  counter_add(&counters->attempts, 1);
+  counter_add(&counters->busy_ns, busy_ns);
+  if (retrying) {
+    counter_add(&counters->retries, 1);
+  }
+
+  switch (stage) {
+    case DHT_STAGE_RESPONSE_LOW:
+      counter_add(&counters->response_low_timeouts, 1);
+      break;
+    case DHT_STAGE_RESPONSE_HIGH:
+      counter_add(&counters->response_high_timeouts, 1);
+      break;
+    case DHT_STAGE_BITS:
+      counter_add(&counters->bit_timeouts, 1);
+      break;
+    case DHT_STAGE_PARITY:
+      counter_add(&counters->parity_failures, 1);
+      break;
+    case DHT_STAGE_RANGE:
+      counter_add(&counters->range_failures, 1);
+      break;
+  }
+}
+
+void stats_count_success(struct stats_file *stats, int pin) {
+  counter_add(&stats->pins[pin].successes, 1);
+  __atomic_store_n(&stats->pins[pin].last_success_ns, stats_now_ns(),
+                   __ATOMIC_RELAXED);
+}
+
+void stats_snapshot(const struct stats_file *stats, int pin,
+                    struct stats_pin *out) {
+  const struct stats_pin *counters = &stats->pins[pin];
+  out->reads = counter_load(&counters->reads);
+  out->successes = counter_load(&counters->successes);
+  out->attempts = counter_load(&counters->attempts);
+  out->retries = counter_load(&counters->retries);
+  out->response_low_timeouts = counter_load(&counters->response_low_timeouts);
+  out->response_high_timeouts = counter_load(&counters->response_high_timeouts);
+  out->bit_timeouts = counter_load(&counters->bit_timeouts);
+  out->parity_failures = counter_load(&counters->parity_failures);
+  out->range_failures = counter_load(&counters->range_failures);
+  out->busy_ns = counter_load(&counters->busy_ns);
+  out->last_success_ns = counter_load(&counters->last_success_ns);
+}
@@ -0,0 +1,58 @@
+#ifndef STATS
+#define STATS
+
+#include "dht.h"
+
+#include <stdint.h>
+
+// Per-pin read counters in a shared memory-mapped file
+//
+// Each process reading a sensor maps the same file and bumps the counters
+// with relaxed atomic adds, so no locks are taken and any number of readers
+// (see dht-stat) can map it read-only and sample it at any time. The default
+// path is on tmpfs, so updates never reach the disk.
+
+#define STATS_MAGIC 0x53544844      // "DHTS", little-endian
+#define STATS_VERSION 2
+#define STATS_PATH "/dev/shm/dht22.stats"
+
+struct stats_pin {
+  uint64_t reads;                   // Calls to DHT_read_data
+  uint64_t successes;
+  uint64_t attempts;
+  uint64_t retries;
+  uint64_t response_low_timeouts;
+  uint64_t response_high_timeouts;
+  uint64_t bit_timeouts;
+  uint64_t parity_failures;
+  uint64_t busy_ns;                 // Time spent driving and polling the line
+  uint64_t last_success_ns;         // CLOCK_MONOTONIC; 0 if never
+  uint64_t range_failures;          // Checksum matched, values out of range
+};
+
+struct stats_file {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t npins;
+  uint32_t reserved;
+  struct stats_pin pins[NUM_PINS];
+};
+
+// Map the stats file at path, creating it if writable and it doesn't exist
+// Returns NULL if it can't be mapped or isn't a stats file of this version
+struct stats_file *stats_open(const char *path, int writable);
+void stats_close(struct stats_file *stats);
+
+// Counting, used while reading; pin must be valid
+void stats_count_read(struct stats_file *stats, int pin);
+void stats_count_attempt(struct stats_file *stats, int pin, int stage,
+                         uint64_t busy_ns, int retrying);
+void stats_count_success(struct stats_file *stats, int pin);
+
+// Consistent-per-field copy of the counters of a pin
+void stats_snapshot(const struct stats_file *stats, int pin,
+                    struct stats_pin *out);
+
+uint64_t stats_now_ns(void);
+
+#endif
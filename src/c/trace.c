@@ -0,0 +1,233 @@
+#include "trace.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CPUFREQ "/sys/devices/system/cpu/cpu0/cpufreq/"
+
+static const char *governors[] = {
+  "unknown", "performance", "powersave", "ondemand",
+  "conservative", "schedutil", "userspace",
+};
+
+const char *trace_governor_str(int governor) {
+  if (governor < 0 ||
+      governor >= (int)(sizeof(governors) / sizeof(governors[0]))) {
+    return governors[TRACE_GOVERNOR_UNKNOWN];
+  }
+  return governors[governor];
+}
+
+// Reads a small sysfs or procfs file into buf, without a trailing newline
+static int read_line(const char *path, char *buf, size_t size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  ssize_t n = read(fd, buf, size - 1);
+  close(fd);
+  if (n <= 0) {
+    return -1;
+  }
+  buf[n] = '\0';
+  buf[strcspn(buf, "\n")] = '\0';
+  return 0;
+}
+
+static uint8_t current_governor(void) {
+  char name[32];
+  if (read_line(CPUFREQ "scaling_governor", name, sizeof(name))) {
+    return TRACE_GOVERNOR_UNKNOWN;
+  }
+  for (size_t i = 1; i < sizeof(governors) / sizeof(governors[0]); i++) {
+    if (!strcmp(name, governors[i])) {
+      return i;
+    }
+  }
+  return TRACE_GOVERNOR_UNKNOWN;
+}
+
+static uint32_t current_khz(void) {
+  char khz[32];
+  if (read_line(CPUFREQ "scaling_cur_freq", khz, sizeof(khz))) {
+    return 0;
+  }
+  return strtoul(khz, NULL, 10);
+}
+
+static uint16_t clamp16(int cycles) {
+  return cycles < 0 ? 0 : cycles > UINT16_MAX ? UINT16_MAX : cycles;
+}
+
+static int write_header(int fd) {
+  struct trace_header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.record_size = sizeof(struct trace_record);
+  if (read_line("/proc/device-tree/model", header.board, sizeof(header.board))) {
+    strcpy(header.board, "unknown");
+  }
+  gethostname(header.host, sizeof(header.host) - 1);
+  return write(fd, &header, sizeof(header)) == sizeof(header) ? 0 : -1;
+}
+
+static int check_header(const struct trace_header *header) {
+  return header->magic == TRACE_MAGIC && header->version == TRACE_VERSION &&
+         header->record_size == sizeof(struct trace_record) ? 0 : -1;
+}
+
+int trace_open(struct trace *trace, const char *path) {
+  if (!trace || !path) {
+    return ERROR_INVAL;
+  }
+  trace->records = 0;
+  trace->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (trace->fd < 0) {
+    debug_print(stderr, "Couldn't open trace %s\n", path);
+    return ERROR_DRIVER;
+  }
+
+  struct stat st;
+  if (fstat(trace->fd, &st)) {
+    goto fail;
+  }
+  if (st.st_size == 0) {
+    if (write_header(trace->fd)) {
+      goto fail;
+    }
+    return NO_ERROR;
+  }
+
+  struct trace_header header;
+  if (pread(trace->fd, &header, sizeof(header), 0) != sizeof(header) ||
+      check_header(&header)) {
+    debug_print(stderr, "%s is not a version %d trace\n", path, TRACE_VERSION);
+    close(trace->fd);
+    trace->fd = -1;
+    return ERROR_INVAL;
+  }
+
+  // Cut off a record torn by a crash, so the next one lands in its place
+  trace->records = (st.st_size - sizeof(header)) / sizeof(struct trace_record);
+  off_t valid = sizeof(header) + trace->records * sizeof(struct trace_record);
+  if (valid < st.st_size && ftruncate(trace->fd, valid)) {
+    goto fail;
+  }
+  return NO_ERROR;
+
+fail:
+  close(trace->fd);
+  trace->fd = -1;
+  return ERROR_DRIVER;
+}
+
+void trace_fill(struct trace_record *record, const struct DHT_attempt *attempt) {
+  memset(record, 0, sizeof(*record));
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  record->time_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+  record->bits_ns = attempt->bits_ns > UINT32_MAX ? UINT32_MAX : attempt->bits_ns;
+  record->pin = attempt->pin;
+  record->attempt = attempt->attempt > UINT8_MAX ? UINT8_MAX : attempt->attempt;
+  record->stage = attempt->stage;
+  record->model = attempt->model;
+  record->ack_low = clamp16(attempt->ack_low_cycles);
+  record->ack_high = clamp16(attempt->ack_high_cycles);
+  for (int i = 0; i < NUM_BITS * 2; i++) {
+    record->cycles[i] = clamp16(attempt->cycles[i]);
+  }
+  if (attempt->data) {
+    memcpy(record->data, attempt->data, NUM_BYTES);
+  }
+}
+
+void trace_stamp_cpu(struct trace_record *record) {
+  record->cpu_khz = current_khz();
+  record->governor = current_governor();
+}
+
+int trace_append(struct trace *trace, const struct DHT_attempt *attempt) {
+  if (!trace || !attempt || trace->fd < 0) {
+    return ERROR_INVAL;
+  }
+
+  struct trace_record record;
+  trace_fill(&record, attempt);
+  trace_stamp_cpu(&record);
+  if (write(trace->fd, &record, sizeof(record)) != sizeof(record)) {
+    debug_print(stderr, "%s\n", "Couldn't append trace record");
+    return ERROR_DRIVER;
+  }
+  trace->records++;
+  return NO_ERROR;
+}
+
+int trace_close(struct trace *trace) {
+  if (!trace || trace->fd < 0) {
+    return ERROR_INVAL;
+  }
+  int err = close(trace->fd) ? ERROR_DRIVER : NO_ERROR;
+  trace->fd = -1;
+  return err;
+}
+
+void trace_hook(void *ctx, const struct DHT_attempt *attempt) {
+  trace_append(ctx, attempt);
+}
+
+int trace_map(struct trace_map *map, const char *path) {
+  if (!map || !path) {
+    return ERROR_INVAL;
+  }
+  memset(map, 0, sizeof(*map));
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return ERROR_DRIVER;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct trace_header)) {
+    close(fd);
+    return ERROR_INVAL;
+  }
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return ERROR_DRIVER;
+  }
+
+  const struct trace_header *header = base;
+  if (check_header(header)) {
+    munmap(base, st.st_size);
+    return ERROR_INVAL;
+  }
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+  map->base = base;
+  map->size = st.st_size;
+  map->header = header;
+  map->records = (const struct trace_record *)(header + 1);
+  map->n = (st.st_size - sizeof(*header)) / sizeof(struct trace_record);
+  return NO_ERROR;
+}
+
+void trace_unmap(struct trace_map *map) {
+  if (map && map->base) {
+    munmap(map->base, map->size);
+    memset(map, 0, sizeof(*map));
+  }
+}
+
+void trace_cycles(const struct trace_record *record, int *cycles) {
+  for (int i = 0; i < NUM_BITS * 2; i++) {
+    cycles[i] = record->cycles[i];
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef TRACE
+#define TRACE
+
+#include "dht.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw waveform recordings
+//
+// A trace file is a header followed by fixed-size records, one for every
+// attempt made while recording: the response and per-bit cycle counts as
+// captured, the outcome, and what the CPU was doing at the time. Records are
+// appended with a single write each, so a crash can only tear the last one,
+// which is cut off the next time the file is opened for recording.
+
+#define TRACE_MAGIC 0x52544844    // "DHTR", little-endian
+#define TRACE_VERSION 1
+#define TRACE_NAME_LEN 48
+
+enum trace_governor {
+  TRACE_GOVERNOR_UNKNOWN,
+  TRACE_GOVERNOR_PERFORMANCE,
+  TRACE_GOVERNOR_POWERSAVE,
+  TRACE_GOVERNOR_ONDEMAND,
+  TRACE_GOVERNOR_CONSERVATIVE,
+  TRACE_GOVERNOR_SCHEDUTIL,
+  TRACE_GOVERNOR_USERSPACE,
+};
+
+struct trace_header {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;             // sizeof(struct trace_record)
+  char board[TRACE_NAME_LEN];       // Device tree model, e.g. Raspberry Pi 3...
+  char host[TRACE_NAME_LEN];        // Host name of the recording device
+};
+
+struct trace_record {
+  int64_t time_ns;                  // Wall clock time the record was written
+  uint32_t cpu_khz;                 // Current CPU frequency, 0 if unknown
+  uint32_t bits_ns;                 // Time taken by the 40 bits, if captured
+  uint8_t pin;
+  uint8_t attempt;                  // 0 for the first attempt of a read
+  uint8_t stage;                    // enum DHT_stage
+  uint8_t governor;                 // enum trace_governor
+  uint16_t ack_low;                 // Response cycles
+  uint16_t ack_high;
+  uint16_t cycles[NUM_BITS * 2];    // Low then high cycles of each bit
+  uint8_t data[NUM_BYTES];          // As decoded, if stage is OK, PARITY or RANGE
+  uint8_t model;                    // enum DHT_model; 0, DHT22, in older traces
+  uint8_t reserved[2];
+};
+
+// Open trace file for appending records
+struct trace {
+  int fd;
+  uint64_t records;
+};
+
+// Mapped trace file
+struct trace_map {
+  void *base;
+  size_t size;
+  const struct trace_header *header;
+  const struct trace_record *records;
+  size_t n;
+};
+
+// Open or create the trace file at path, cutting off any torn record
+// Returns ERROR_INVAL if the file exists but isn't a trace of this version
+int trace_open(struct trace *trace, const char *path);
+
+// Build the record of one attempt, stamped with the time
+void trace_fill(struct trace_record *record, const struct DHT_attempt *attempt);
+
+// Stamp a record with the CPU frequency and governor, read from sysfs
+void trace_stamp_cpu(struct trace_record *record);
+
+// Append the record of one attempt, stamped with the time and CPU
+int trace_append(struct trace *trace, const struct DHT_attempt *attempt);
+
+int trace_close(struct trace *trace);
+
+// DHT_attempt_hook appending to the struct trace passed as ctx
+void trace_hook(void *ctx, const struct DHT_attempt *attempt);
+
+// Map the whole records of a trace file read-only
+int trace_map(struct trace_map *map, const char *path);
+void trace_unmap(struct trace_map *map);
+
+// Widen a record's bit cycles to the ints the decoders take
+void trace_cycles(const struct trace_record *record, int *cycles);
+
+const char *trace_governor_str(int governor);
+
+#endif
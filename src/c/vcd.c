@@ -0,0 +1,238 @@
+#include "vcd.h"
+
+#include "decode.h"
+#include "dht.h"
+#include "model.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define END_LOW_NS 50000      // Sensor's low after the last bit, not measured
+
+// Variables in the dump
+enum var { HOST, LINE, BIT, VALUE, WEAK, VARS };
+
+static const struct {
+  const char *id;
+  int width;
+  const char *name;
+  const char *initial;
+} vars[VARS] = {
+  {"!", 1, "host", "0"},      // Host is driving the line
+  {"\"", 1, "data", "1"},
+  {"#", 6, "bit", "bx "},     // Index of the bit being sent
+  {"$", 1, "value", "x"},     // Value decoded from it
+  {"%", 1, "weak", "0"},      // High and low differ by < VCD_WEAK_PERCENT
+};
+
+struct writer {
+  char *buf;
+  size_t size;
+  size_t length;
+  int64_t written;            // Time of the last timestamp written
+  char values[VARS][9];       // Last value written for each variable
+};
+
+// Appends to buf while there is room, but always counts the full length
+__attribute__((format(printf, 2, 3)))
+static void append(struct writer *w, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(w->length < w->size ? w->buf + w->length : NULL,
+                    w->length < w->size ? w->size - w->length : 0, fmt, args);
+  va_end(args);
+  w->length += n > 0 ? n : 0;
+}
+
+static void timestamp(struct writer *w, int64_t t) {
+  if (t != w->written) {
+    append(w, "#%lld\n", (long long)t);
+    w->written = t;
+  }
+}
+
+// Appends a change of var at time t, if its value did change
+static void change(struct writer *w, int64_t t, enum var var, const char *value) {
+  if (!strcmp(w->values[var], value)) {
+    return;
+  }
+  timestamp(w, t);
+  append(w, "%s%s\n", value, vars[var].id);
+  snprintf(w->values[var], sizeof(w->values[var]), "%s", value);
+}
+
+// Index of the bit being sent as a 6-bit vector, or x between bits
+static void change_bit(struct writer *w, int64_t t, int bit) {
+  char value[9] = "bx ";
+  if (bit >= 0) {
+    value[0] = 'b';
+    for (int i = 0; i < 6; i++) {
+      value[i + 1] = '0' + ((bit >> (5 - i)) & 1);
+    }
+    value[7] = ' ';
+    value[8] = '\0';
+  }
+  change(w, t, BIT, value);
+}
+
+// Nanoseconds per poll, from the time taken by the captured bits
+static double poll_ns(const struct trace_record *record, double fallback) {
+  uint64_t polls = 0;
+  for (int i = 0; i < NUM_BITS * 2; i++) {
+    polls += record->cycles[i];
+  }
+  return record->bits_ns && polls ? (double)record->bits_ns / polls : fallback;
+}
+
+// Start signal's low for the model the record was made with, e.g. 18 ms
+// for a DHT11
+static int64_t start_low_ns(const struct trace_record *record) {
+  const struct DHT_model_info *model = DHT_model_info(record->model);
+  if (!model) {
+    model = DHT_model_info(DHT_MODEL_DHT22);
+  }
+  return model->start_low_us * 1000LL;
+}
+
+static int64_t duration_ns(const struct trace_record *record, double ns) {
+  uint64_t polls = record->ack_low + record->ack_high;
+  for (int i = 0; i < NUM_BITS * 2; i++) {
+    polls += record->cycles[i];
+  }
+  return start_low_ns(record) + HOST_STARTSIG_WAIT_TIME_US * 1000LL +
+         (int64_t)(polls * ns) + END_LOW_NS;
+}
+
+// Draws one attempt starting at t; returns the time it ends
+static int64_t draw_attempt(struct writer *w, const struct trace_record *record,
+                            int64_t t, double ns) {
+  uint8_t data[NUM_BYTES];
+  int cycles[NUM_BITS * 2];
+  trace_cycles(record, cycles);
+  int captured = record->stage == DHT_STAGE_OK ||
+                 record->stage == DHT_STAGE_PARITY ||
+                 record->stage == DHT_STAGE_RANGE;
+  int parity = DHT_process_data(cycles, data);
+
+  timestamp(w, t);
+  append(w, "$comment pin %u attempt %u: %s", record->pin, record->attempt,
+         DHT_stage_str(record->stage));
+  if (captured) {
+    append(w, ", %02x %02x %02x %02x %02x%s", data[0], data[1], data[2],
+           data[3], data[4], parity ? " (parity)" : "");
+  }
+  if (record->cpu_khz) {
+    append(w, ", %u MHz %s", record->cpu_khz / 1000,
+           trace_governor_str(record->governor));
+  }
+  append(w, " $end\n");
+
+  // Start signal: host pulls the line low, then high, then lets go
+  change(w, t, HOST, "1");
+  change(w, t, LINE, "0");
+  t += start_low_ns(record);
+  change(w, t, LINE, "1");
+  t += HOST_STARTSIG_WAIT_TIME_US * 1000LL;
+  change(w, t, HOST, "0");
+  if (record->stage == DHT_STAGE_RESPONSE_LOW) {
+    return t;
+  }
+
+  // Response, taken to start as the host lets go
+  change(w, t, LINE, "0");
+  t += (int64_t)(record->ack_low * ns);
+  if (record->stage == DHT_STAGE_RESPONSE_HIGH) {
+    return t;
+  }
+  change(w, t, LINE, "1");
+  t += (int64_t)(record->ack_high * ns);
+
+  // Bits; a level of no polls was missed, so leave the line where it is
+  for (int i = 0; i < NUM_BITS; i++) {
+    int low = cycles[i*2], high = cycles[i*2+1];
+    change_bit(w, t, i);
+    if (low) {
+      change(w, t, LINE, "0");
+      change(w, t, VALUE, "x");
+      change(w, t, WEAK, "0");
+      t += (int64_t)(low * ns);
+    }
+    if (high) {
+      int weak = abs(high - low) * 100 < VCD_WEAK_PERCENT * (low ? low : 1);
+      change(w, t, LINE, "1");
+      change(w, t, VALUE, (data[i/8] >> (7 - i%8)) & 1 ? "1" : "0");
+      change(w, t, WEAK, weak ? "1" : "0");
+      t += (int64_t)(high * ns);
+    }
+  }
+
+  change_bit(w, t, -1);
+  change(w, t, LINE, "0");
+  change(w, t, VALUE, "x");
+  change(w, t, WEAK, "0");
+  t += END_LOW_NS;
+  change(w, t, LINE, "1");
+  return t;
+}
+
+size_t vcd_format(const struct trace_record *records, size_t n,
+                  char *buf, size_t size) {
+  struct writer w = {buf, size, 0, -1, {""}};
+
+  char date[64] = "";
+  if (n) {
+    time_t seconds = records[0].time_ns / 1000000000LL;
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S UTC", gmtime(&seconds));
+  }
+  append(&w, "$date %s $end\n$version dht-cli $end\n$timescale 1ns $end\n", date);
+  append(&w, "$scope module dht $end\n");
+  for (int i = 0; i < VARS; i++) {
+    append(&w, "$var wire %d %s %s $end\n", vars[i].width, vars[i].id, vars[i].name);
+  }
+  append(&w, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+  for (int i = 0; i < VARS; i++) {
+    append(&w, "%s%s\n", vars[i].initial, vars[i].id);
+    snprintf(w.values[i], sizeof(w.values[i]), "%s", vars[i].initial);
+  }
+  append(&w, "$end\n");
+  w.written = 0;
+
+  // Records are stamped once the attempt is over, so each is drawn ending
+  // at its stamp, but never overlapping the one before
+  double ns = VCD_POLL_NS;
+  int64_t origin = 0, end = 0;
+  for (size_t i = 0; i < n; i++) {
+    ns = poll_ns(&records[i], ns);
+    int64_t start = records[i].time_ns - duration_ns(&records[i], ns);
+    if (i == 0) {
+      origin = start;
+    }
+    start -= origin;
+    end = draw_attempt(&w, &records[i], start > end ? start : end, ns);
+  }
+  return w.length;
+}
+
+int vcd_write(const char *path, const struct trace_record *records, size_t n) {
+  size_t length = vcd_format(records, n, NULL, 0);
+  char *buf = malloc(length + 1);
+  if (!buf) {
+    return ERROR_INVAL;
+  }
+  vcd_format(records, n, buf, length + 1);
+
+  int to_stdout = !strcmp(path, "-");
+  FILE *file = to_stdout ? stdout : fopen(path, "w");
+  int err = ERROR_DRIVER;
+  if (file) {
+    err = fwrite(buf, 1, length, file) == length ? NO_ERROR : ERROR_DRIVER;
+    if (!to_stdout && fclose(file)) {
+      err = ERROR_DRIVER;
+    }
+  }
+  free(buf);
+  return err;
+}
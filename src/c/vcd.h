@@ -0,0 +1,29 @@
+#ifndef VCD
+#define VCD
+
+#include "trace.h"
+
+#include <stddef.h>
+
+// Value Change Dump export of captured attempts, for GTKWave or sigrok
+//
+// Each attempt is drawn at its wall clock time, relative to the first one,
+// with the host's start signal, the sensor's response and the 40 bits. Poll
+// counts are turned into time with the polling rate measured over the bits.
+// Besides the line itself, the dump has the index of the bit being sent, the
+// value the default decoder reads from it, and a flag on bits whose high and
+// low differ by less than VCD_WEAK_PERCENT. Each attempt starts with a
+// comment giving its pin, outcome and decoded bytes.
+
+#define VCD_WEAK_PERCENT 20
+#define VCD_POLL_NS 200       // Assumed when no bits were captured to measure
+
+// Writes the dump of records[0..n) into buf like snprintf, truncating to
+// size; returns the full length, so buf may be NULL to measure it first
+size_t vcd_format(const struct trace_record *records, size_t n,
+                  char *buf, size_t size);
+
+// Writes the dump of records[0..n) to the file at path, or stdout if "-"
+int vcd_write(const char *path, const struct trace_record *records, size_t n);
+
+#endif
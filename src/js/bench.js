@@ -0,0 +1,93 @@
+// Calls per second and garbage collections of each way to get a reading
+//
+// Needs the addon built against the simulated sensor (npm run build:sim),
+// since a real DHT22 can only be read every 2 seconds.
+
+const perfHooks = require('perf_hooks');
+const DHT22 = require('bindings')('homebridge-dht22');
+
+const PIN = 4;
+const PINS = [4, 17, 27, 22];
+const RETRIES = 1;
+const SECONDS = 2;
+
+if (DHT22.backend !== 'simulator') {
+  console.error('Build the addon with the simulator backend first: npm run build:sim');
+  process.exit(1);
+}
+
+let collections = 0;
+const observer = new perfHooks.PerformanceObserver((list) => {
+  collections += list.getEntries().length;
+});
+observer.observe({ entryTypes: ['gc'] });
+
+const result = new Float64Array(DHT22.resultFields.length);
+const resultObject = {};
+const batchOptions = { retries: RETRIES, out: new Float64Array(PINS.length * 4) };
+// As index.js reads, through the filter and the estimator
+const readOptions = {
+  filterWindow: 7,
+  filterThreshold: 3,
+  tempMinDeviation: 5,
+  humMinDeviation: 10,
+  adaptive: true,
+  minInterval: 5,
+  maxInterval: 600,
+  model: 'DHT22',
+};
+
+function getDataEach() {
+  for (let i = 0; i < PINS.length; i++) {
+    DHT22.getData(PINS[i], RETRIES);
+  }
+}
+
+const variants = [
+  ['getData', () => DHT22.getData(PIN, RETRIES)],
+  ['getDataInto(Float64Array)', () => DHT22.getDataInto(PIN, RETRIES, result)],
+  ['getDataInto(object)', () => DHT22.getDataInto(PIN, RETRIES, resultObject)],
+  ['getDataInto(object, options)',
+   () => DHT22.getDataInto(PIN, RETRIES, resultObject, readOptions)],
+  [`getData x${PINS.length}`, getDataEach],
+  [`getDataBatch(${PINS.length} pins)`, () => DHT22.getDataBatch(PINS, batchOptions)],
+];
+
+function run(name, fn) {
+  // Warm up, and let the observer catch up with earlier collections
+  for (let i = 0; i < 1000; i++) {
+    fn();
+  }
+  return new Promise((resolve) => setImmediate(() => {
+    collections = 0;
+    const heapBefore = process.memoryUsage().heapUsed;
+    const start = process.hrtime.bigint();
+    const end = start + BigInt(SECONDS * 1e9);
+    let calls = 0;
+    let now = start;
+    while (now < end) {
+      for (let i = 0; i < 100; i++) {
+        fn();
+      }
+      calls += 100;
+      now = process.hrtime.bigint();
+    }
+    const seconds = Number(now - start) / 1e9;
+    const heapGrowth = process.memoryUsage().heapUsed - heapBefore;
+
+    // gc entries are delivered asynchronously
+    setImmediate(() => {
+      console.log(`${name.padEnd(30)} ${(calls / seconds).toFixed(0).padStart(10)} calls/s` +
+                  `  ${String(collections).padStart(5)} GCs` +
+                  `  heap ${(heapGrowth / 1024).toFixed(0).padStart(7)} KiB`);
+      resolve();
+    });
+  }));
+}
+
+(async () => {
+  for (const [name, fn] of variants) {
+    await run(name, fn);
+  }
+  observer.disconnect();
+})();
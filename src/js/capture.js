@@ -0,0 +1,58 @@
+// Views over the ring of raw capture timings returned by captureBuffer
+//
+// The ring is native memory that each read updates in place, laid out as in
+// src/c/capture_ring.h. The typed arrays for every slot are made once here,
+// so reading waveforms afterwards copies and allocates nothing.
+
+const HEADER_BYTES = 16;
+const SLOT_BYTES = 232;
+const NUM_BITS = 40;
+
+// Decision of a bit that wasn't captured
+const BIT_NONE = 0xFF;
+
+class CaptureRing {
+  constructor(buffer) {
+    this.header = new Uint32Array(buffer, 0, 4);
+    this.capacity = this.header[0];
+    if (this.header[1] !== SLOT_BYTES) {
+      throw new Error(`Capture slots are ${this.header[1]} bytes, expected ${SLOT_BYTES}`);
+    }
+
+    this.slots = [];
+    for (let i = 0; i < this.capacity; i++) {
+      const offset = HEADER_BYTES + i * SLOT_BYTES;
+      this.slots.push({
+        time: new Float64Array(buffer, offset, 1),            // Wall clock, ms
+        seqAndBitsNs: new Uint32Array(buffer, offset + 8, 2),
+        // pin, attempt, stage, and 1 if the checksum matched, even when the
+        // values were then out of the model's range
+        info: new Uint8Array(buffer, offset + 16, 4),
+        ack: new Uint16Array(buffer, offset + 20, 2),         // Response low, high cycles
+        cycles: new Uint16Array(buffer, offset + 24, NUM_BITS * 2),
+        bits: new Uint8Array(buffer, offset + 184, NUM_BITS),
+        data: new Uint8Array(buffer, offset + 224, 5),
+      });
+    }
+  }
+
+  // Number of attempts captured since the ring was created
+  get count() {
+    return this.header[2];
+  }
+
+  // Views of the nth most recent attempt, 0 being the newest, or null if the
+  // ring doesn't hold it
+  recent(n = 0) {
+    const count = this.count;
+    if (n >= count || n >= this.capacity) {
+      return null;
+    }
+    return this.slots[(count - 1 - n) % this.capacity];
+  }
+}
+
+module.exports = {
+  BIT_NONE,
+  CaptureRing,
+};
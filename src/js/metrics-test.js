@@ -0,0 +1,176 @@
+// Scrapes the OpenMetrics exporter over HTTP like Prometheus would, checks
+// the exposition against the format rules it depends on, and times scrapes
+// Runs without the native module or a sensor: node src/js/metrics-test.js
+
+const assert = require('assert');
+const http = require('http');
+
+const Metrics = require('./metrics');
+
+const SCRAPES = 200;
+
+const log = {
+  error: message => { throw new Error(message); },
+};
+
+// Cumulative bucket counts like the binding's latencyHistogram returns
+function fakeHistogram(durations) {
+  const buckets = new Float64Array(Metrics.LATENCY_BOUNDS.length);
+  Metrics.LATENCY_BOUNDS.forEach((bound, i) => {
+    buckets[i] = durations.filter(d => d <= bound).length;
+  });
+  return {
+    count: durations.length,
+    sum: durations.reduce((a, b) => a + b, 0),
+    buckets: buckets,
+  };
+}
+
+function fakeData(temp, hum) {
+  const latency = {};
+  Metrics.PHASES.forEach((phase, i) => {
+    latency[phase] = fakeHistogram([0.00002 * (i + 1), 0.004, 0.0045, 0.52 * i]);
+  });
+  return {
+    temp: temp,
+    hum: hum,
+    time: 1700000000,
+    reads: 12,
+    errors: 1,
+    rejected: 2,
+    blockedSeconds: 0.061,
+    latency: latency,
+    stats: {
+      attempts: 20,
+      retries: 8,
+      responseLowTimeouts: 3,
+      responseHighTimeouts: 0,
+      bitTimeouts: 2,
+      parityFailures: 3,
+      rangeFailures: 1,
+      busySeconds: 0.113,
+    },
+  };
+}
+
+function scrape(port, path) {
+  return new Promise((resolve, reject) => {
+    http.get({host: '127.0.0.1', port: port, path: path}, res => {
+      const chunks = [];
+      res.on('data', chunk => chunks.push(chunk));
+      res.on('end', () => resolve({
+        status: res.statusCode,
+        type: res.headers['content-type'],
+        body: Buffer.concat(chunks).toString(),
+      }));
+    }).on('error', reject);
+  });
+}
+
+// Checks the parts of the OpenMetrics text format a scraper relies on
+function validate(body) {
+  assert(body.endsWith('# EOF\n'), 'exposition must end with # EOF');
+  const lines = body.slice(0, -'# EOF\n'.length).split('\n').slice(0, -1);
+  const types = {};
+  const series = new Set();
+  const buckets = {};
+  let family = null;
+
+  for (const line of lines) {
+    let match = line.match(/^# (TYPE|UNIT|HELP) ([a-zA-Z_:][a-zA-Z0-9_:]*) (.+)$/);
+    if (match) {
+      if (match[1] === 'TYPE') {
+        assert(!types[match[2]], `family ${match[2]} declared twice`);
+        family = match[2];
+        types[family] = match[3];
+      } else {
+        assert.strictEqual(match[2], family, `${match[1]} outside its family`);
+      }
+      if (match[1] === 'UNIT') {
+        assert(family.endsWith(`_${match[3]}`), `${family} must end with its unit`);
+      }
+      continue;
+    }
+
+    match = line.match(/^([a-zA-Z_:][a-zA-Z0-9_:]*)\{((?:[a-zA-Z_][a-zA-Z0-9_]*="(?:[^"\\\n]|\\[\\n"])*",?)*)\} (\S+)$/);
+    assert(match, `malformed sample: ${line}`);
+    const [, name, labels, value] = match;
+    assert(value === '+Inf' || !isNaN(Number(value)), `bad value: ${line}`);
+    assert(!series.has(name + labels), `duplicate sample: ${line}`);
+    series.add(name + labels);
+
+    const suffixes = {
+      gauge: [''],
+      counter: ['_total'],
+      histogram: ['_bucket', '_count', '_sum'],
+    }[types[family]];
+    assert(suffixes.some(suffix => name === family + suffix),
+           `${name} doesn't belong to ${types[family]} ${family}`);
+
+    // Buckets must be cumulative, ending in +Inf equal to _count
+    const key = labels.replace(/,?le="[^"]*"/, '');
+    if (name.endsWith('_bucket')) {
+      const previous = buckets[key];
+      assert(!previous || Number(value) >= previous.value, `buckets decrease: ${line}`);
+      buckets[key] = {value: Number(value), inf: labels.includes('le="+Inf"')};
+    } else if (name.endsWith('_count') && types[family] === 'histogram') {
+      assert(buckets[key] && buckets[key].inf, `${line} without +Inf bucket`);
+      assert.strictEqual(Number(value), buckets[key].value, `+Inf bucket != count`);
+    }
+  }
+  return series.size;
+}
+
+async function main() {
+  const exporter = new Metrics.MetricsExporter(0, '127.0.0.1', log, {loopInterval: 0.05});
+  await new Promise(resolve => exporter.server.once('listening', resolve));
+  const port = exporter.server.address().port;
+
+  // Only the event loop family, and its header, before any reading
+  let result = await scrape(port, '/metrics');
+  assert.strictEqual(result.status, 200);
+  assert.strictEqual(result.type, Metrics.CONTENT_TYPE);
+  validate(result.body);
+
+  // Two sensors sharing the endpoint; one name needs escaping
+  exporter.addSource({pin: 4, name: 'Office'}).update(fakeData(21.3, 45.2));
+  const other = exporter.addSource({pin: 17, name: 'Say "hi"\\ \n'});
+  other.update(fakeData(-4.1, 80));
+  await new Promise(resolve => setTimeout(resolve, 100));
+
+  result = await scrape(port, '/metrics');
+  const samples = validate(result.body);
+  assert(result.body.includes('dht22_temperature_celsius{pin="17",name="Say \\"hi\\"\\\\ \\n"} -4.1'));
+  assert(result.body.includes('dht22_timeouts_total{pin="4",name="Office",phase="bits"} 2'));
+  assert(/dht22_event_loop_delay_seconds\{stat="p99"\} \d/.test(result.body));
+  assert.strictEqual((await scrape(port, '/')).status, 404);
+
+  // A scrape serves the pre-rendered buffer
+  const fakeResponse = {writeHead() {}, end() {}};
+  const request = {method: 'GET', url: '/metrics'};
+  let start = process.hrtime.bigint();
+  for (let i = 0; i < 10000; i++) {
+    exporter.serve(request, fakeResponse);
+  }
+  const serveNs = Number(process.hrtime.bigint() - start) / 10000;
+
+  start = process.hrtime.bigint();
+  for (let i = 0; i < SCRAPES; i++) {
+    await scrape(port, '/metrics');
+  }
+  const scrapeNs = Number(process.hrtime.bigint() - start) / SCRAPES;
+
+  other.remove();
+  validate((await scrape(port, '/metrics')).body);
+  await new Promise(resolve => exporter.close(resolve));
+
+  console.log(`${samples} samples, ${result.body.length} bytes`);
+  console.log(`serve: ${(serveNs / 1000).toFixed(2)} us, ` +
+              `HTTP scrape round trip: ${(scrapeNs / 1000).toFixed(1)} us`);
+  console.log('OK');
+}
+
+main().catch(err => {
+  console.error(err);
+  process.exit(1);
+});
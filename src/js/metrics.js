@@ -0,0 +1,237 @@
+// OpenMetrics exporter for sensor readings and acquisition performance
+//
+// Scrapes must be cheap, since they can arrive while a read is in progress
+// on the same event loop. The header of every metric family is rendered once
+// up front, each source renders its samples when it is updated, and the
+// whole exposition is concatenated into one Buffer right away; a scrape only
+// writes that Buffer out.
+
+const http = require('http');
+const perfHooks = require('perf_hooks');
+
+const CONTENT_TYPE = 'application/openmetrics-text; version=1.0.0; charset=utf-8';
+
+// Upper bounds of read duration buckets, in seconds
+const LATENCY_BOUNDS = Float64Array.from([
+  0.00001, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005,
+  0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30,
+]);
+
+// Phases of a read, as named by the binding
+const PHASES = ['init', 'start', 'response', 'bits', 'decode', 'total'];
+
+// Timeout counters by the phase that timed out
+const TIMEOUTS = {
+  response_low: 'responseLowTimeouts',
+  response_high: 'responseHighTimeouts',
+  bits: 'bitTimeouts',
+};
+
+// Every family, in exposition order: [name, type, unit, help]
+const FAMILIES = [
+  ['dht22_temperature_celsius', 'gauge', 'celsius', 'Last accepted temperature'],
+  ['dht22_relative_humidity_percent', 'gauge', 'percent', 'Last accepted relative humidity'],
+  ['dht22_last_reading_timestamp_seconds', 'gauge', 'seconds', 'Time of the last accepted reading'],
+  ['dht22_read_duration_seconds', 'histogram', 'seconds', 'Duration of each phase of a read; total includes retries'],
+  ['dht22_reads', 'counter', '', 'Reads of the sensor'],
+  ['dht22_read_errors', 'counter', '', 'Reads that failed after all retries'],
+  ['dht22_rejected_readings', 'counter', '', 'Readings rejected by the outlier filter'],
+  ['dht22_attempts', 'counter', '', 'Attempts to read the sensor, including retries'],
+  ['dht22_retries', 'counter', '', 'Attempts that were retried'],
+  ['dht22_timeouts', 'counter', '', 'Attempts that timed out, by phase'],
+  ['dht22_parity_failures', 'counter', '', 'Attempts that failed the checksum'],
+  ['dht22_range_failures', 'counter', '', 'Attempts whose checksum matched but values were out of range'],
+  ['dht22_busy_seconds', 'counter', 'seconds', 'Time spent driving and polling the data line'],
+  ['dht22_event_loop_blocked_seconds', 'counter', 'seconds', 'Time reads blocked the event loop'],
+  ['dht22_event_loop_delay_seconds', 'gauge', 'seconds', 'Event loop delay over the last interval'],
+];
+
+const EVENT_LOOP_FAMILY = 'dht22_event_loop_delay_seconds';
+
+function escapeLabel(value) {
+  return String(value).replace(/\\/g, '\\\\').replace(/\n/g, '\\n').replace(/"/g, '\\"');
+}
+
+function formatValue(value) {
+  if (value === Infinity) {
+    return '+Inf';
+  }
+  return Number.isFinite(value) ? String(value) : 'NaN';
+}
+
+function renderHeader(name, type, unit, help) {
+  let header = `# TYPE ${name} ${type}\n`;
+  if (unit) {
+    header += `# UNIT ${name} ${unit}\n`;
+  }
+  return Buffer.from(header + `# HELP ${name} ${help}\n`);
+}
+
+// One sensor; its samples are rendered by update()
+function MetricsSource(exporter, labels) {
+  this.exporter = exporter;
+  this.labels = Object.keys(labels)
+    .map(key => `${key}="${escapeLabel(labels[key])}"`).join(',');
+  this.samples = {};
+}
+
+// Renders the samples of this source from:
+// {temp, hum, time, reads, errors, rejected, blockedSeconds,
+//  latency: {phase: {count, sum, buckets}}, stats: {...} from readStats}
+// Missing parts are left out of the exposition
+MetricsSource.prototype.update = function(data) {
+  const samples = {};
+  const add = (family, name, value, extra) => {
+    const labels = extra ? `${this.labels},${extra}` : this.labels;
+    samples[family] = (samples[family] || '') + `${name}{${labels}} ${formatValue(value)}\n`;
+  };
+  const gauge = (family, value) => {
+    if (value != null) {
+      add(family, family, value);
+    }
+  };
+  gauge('dht22_temperature_celsius', data.temp);
+  gauge('dht22_relative_humidity_percent', data.hum);
+  gauge('dht22_last_reading_timestamp_seconds', data.time);
+
+  if (data.latency) {
+    const family = 'dht22_read_duration_seconds';
+    for (const phase of PHASES) {
+      const hist = data.latency[phase];
+      if (!hist) {
+        continue;
+      }
+      for (let i = 0; i < LATENCY_BOUNDS.length; i++) {
+        add(family, `${family}_bucket`, hist.buckets[i],
+            `phase="${phase}",le="${LATENCY_BOUNDS[i]}"`);
+      }
+      add(family, `${family}_bucket`, hist.count, `phase="${phase}",le="+Inf"`);
+      add(family, `${family}_count`, hist.count, `phase="${phase}"`);
+      add(family, `${family}_sum`, hist.sum, `phase="${phase}"`);
+    }
+  }
+
+  const counter = (family, value, extra) => {
+    if (value != null) {
+      add(family, `${family}_total`, value, extra);
+    }
+  };
+  counter('dht22_reads', data.reads);
+  counter('dht22_read_errors', data.errors);
+  counter('dht22_rejected_readings', data.rejected);
+  counter('dht22_event_loop_blocked_seconds', data.blockedSeconds);
+  if (data.stats) {
+    counter('dht22_attempts', data.stats.attempts);
+    counter('dht22_retries', data.stats.retries);
+    for (const phase of Object.keys(TIMEOUTS)) {
+      counter('dht22_timeouts', data.stats[TIMEOUTS[phase]], `phase="${phase}"`);
+    }
+    counter('dht22_parity_failures', data.stats.parityFailures);
+    counter('dht22_range_failures', data.stats.rangeFailures);
+    counter('dht22_busy_seconds', data.stats.busySeconds);
+  }
+
+  for (const name of Object.keys(samples)) {
+    samples[name] = Buffer.from(samples[name]);
+  }
+  this.samples = samples;
+  this.exporter.render();
+}
+
+MetricsSource.prototype.remove = function() {
+  this.exporter.sources.delete(this);
+  this.exporter.render();
+}
+
+// HTTP server for one port, shared by every source registered on it
+function MetricsExporter(port, host, log, options = {}) {
+  this.port = port;
+  this.log = log;
+  this.sources = new Set();
+  this.headers = FAMILIES.map(family => renderHeader(...family));
+  this.eof = Buffer.from('# EOF\n');
+
+  // Event loop delay, sampled by Node itself; rendered on a timer
+  this.loopDelay = perfHooks.monitorEventLoopDelay({resolution: 10});
+  this.loopDelay.enable();
+  this.loopSamples = Buffer.alloc(0);
+  this.loopTimer = setInterval(() => this.sampleEventLoop(),
+                               (options.loopInterval || 10) * 1000);
+  this.loopTimer.unref();
+
+  this.render();
+  this.server = http.createServer((req, res) => this.serve(req, res));
+  this.server.on('error', err => this.log.error(`Metrics server error: ${err.message}`));
+  this.server.listen(port, host);
+}
+
+MetricsExporter.prototype.addSource = function(labels) {
+  const source = new MetricsSource(this, labels);
+  this.sources.add(source);
+  return source;
+}
+
+MetricsExporter.prototype.sampleEventLoop = function() {
+  const family = EVENT_LOOP_FAMILY;
+  const delay = this.loopDelay;
+  this.loopSamples = Buffer.from(
+    `${family}{stat="p50"} ${delay.percentile(50) / 1e9}\n` +
+    `${family}{stat="p99"} ${delay.percentile(99) / 1e9}\n` +
+    `${family}{stat="max"} ${delay.max / 1e9}\n`);
+  delay.reset();
+  this.render();
+}
+
+// Concatenates the pre-rendered headers and samples into the exposition
+MetricsExporter.prototype.render = function() {
+  const parts = [];
+  FAMILIES.forEach(([name], i) => {
+    parts.push(this.headers[i]);
+    if (name === EVENT_LOOP_FAMILY) {
+      parts.push(this.loopSamples);
+      return;
+    }
+    for (const source of this.sources) {
+      if (source.samples[name]) {
+        parts.push(source.samples[name]);
+      }
+    }
+  });
+  parts.push(this.eof);
+  this.body = Buffer.concat(parts);
+}
+
+MetricsExporter.prototype.serve = function(req, res) {
+  if (req.method !== 'GET' || req.url.split('?')[0] !== '/metrics') {
+    res.writeHead(404);
+    res.end();
+    return;
+  }
+  res.writeHead(200, {'Content-Type': CONTENT_TYPE, 'Content-Length': this.body.length});
+  res.end(this.body);
+}
+
+MetricsExporter.prototype.close = function(callback) {
+  clearInterval(this.loopTimer);
+  this.loopDelay.disable();
+  this.server.close(callback);
+  exporters.delete(this.port);
+}
+
+// One exporter per port, so several accessories can share an endpoint
+const exporters = new Map();
+
+function exporter(port, host, log, options) {
+  if (!exporters.has(port)) {
+    exporters.set(port, new MetricsExporter(port, host, log, options));
+  }
+  return exporters.get(port);
+}
+
+module.exports = {
+  CONTENT_TYPE,
+  LATENCY_BOUNDS,
+  PHASES,
+  MetricsExporter,
+  exporter,
+};
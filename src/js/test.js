@@ -1,3 +1,3 @@
-const DHT22 = require('bindings')('homebridge-dht22');
-
-console.log(DHT22.getData(4, 50));
+const DHT22 = require('bindings')('homebridge-dht22');
+
+console.log(DHT22.getData(4, 50));